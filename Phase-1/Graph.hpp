@@ -1,48 +1,65 @@
 #pragma once
 // Even if Graph.hpp was included multiple time to avoid redefinition error
 
+#include<iostream>
 #include<vector>
 #include<string>
 #include<unordered_map>
-#include<unordered_set>
+#include<limits>
+#include<cstdint>
+#include<cstring>
+#include<cmath>
+#include<bitset>
+#include<functional>
+#include<memory>
+#include<algorithm>
 #include "json.hpp"
+#include "cow.hpp"
 
 using json = nlohmann::json;
 
 struct Node{
     int id;
     double lat , lon;
-    std::vector<std::string> pois;
+    std::vector<int> pois;// indices into Graph::poiTags
 
     Node() : id(0), lat(0.0), lon(0.0), pois({}) {}
 
-    Node(int id, double lat, double lon, const std::vector<std::string>& pois)
+    Node(int id, double lat, double lon, const std::vector<int>& pois)
     : id(id), lat(lat), lon(lon), pois(pois) {}
 
 };
 
+// Road types are interned per graph, so an edge holds a small id and a set of
+// them is a bitmask
+constexpr int MAX_ROAD_TYPES = 256;
+using RoadTypeMask = std::bitset<MAX_ROAD_TYPES>;
+
+// Slice of Graph::profileValues holding a speed profile. Profiles loaded with
+// the graph are shared by every edge with the same speeds, and a constant one
+// keeps a single value. A patched profile gets a run owned by its edge
+struct ProfileRef{
+    int begin , count;
+    bool owned;// the edge's own run, rewritten in place by the next patch
+};
+
+// Hash of the speeds -> stored profile, kept by a loader while it dedups
+using ProfileIndex = std::unordered_multimap<uint64_t , ProfileRef>;
+
 struct Edge{
     int id , u , v;
     double length , average_time;
     bool oneway;
-    std::string road_type;
-    std::vector<double> speed_profile;
-    bool reverse;
+    uint8_t roadType;// index into Graph::roadTypes
+    ProfileRef profile;// speeds in Graph::profileValues
+    bool removed;// removed edges keep their dense index and arc slots
     // To check if two edges are equal we are checking by id
     bool operator==(const Edge& other) const{
         return id == other.id;
     }
 
-    Edge Reverse() const{
-        Edge rev = *this;
-        std::swap(rev.u , rev.v);
-        rev.id *= -1;
-        rev.reverse = !rev.reverse;  
-        return rev;
-    }
-
     Edge() : id(0), u(0), v(0), length(0.0), average_time(0.0),
-            oneway(false), road_type(""), speed_profile({}), reverse(false) {}
+            oneway(false), roadType(0), profile({0 , 0 , false}), removed(false) {}
 
     Edge(int id,
          int u,
@@ -50,101 +67,494 @@ struct Edge{
          double length,
          double average_time,
          bool oneway,
-         const std::string& road_type,
-         const std::vector<double>& speed_profile,
-         bool reverse = false)
+         uint8_t roadType,
+         ProfileRef profile)
         : id(id),
           u(u),
           v(v),
           length(length),
           average_time(average_time),
           oneway(oneway),
-          road_type(road_type),
-          speed_profile(speed_profile),
-          reverse(reverse) {}
+          roadType(roadType),
+          profile(profile),
+          removed(false) {}
 };
 
 
-// Custom hash
-struct EdgeHash{
-    size_t operator()(const Edge& e) const{
-        return std::hash<int>()(e.id);
-    }
+constexpr double DAY_SECONDS = 86400.0;
+constexpr int SPEED_PROFILE_VALUES = 96;// speeds in a full speed_profile, one per bucket
+
+// Breakpoint of an edge's travel-time function at a speed bucket start.
+// raw is length / speed; closed also allows waiting for a later, faster bucket
+struct TtfPoint{
+    double raw , closed;
+};
+
+// Slice of Graph::ttfPoints holding one edge's breakpoints, evenly spread over a day.
+// lo and hi bound the travel time at any departure
+struct TtfRef{
+    int begin , count;
+    double lo , hi;
 };
 
+// One weight per arc slot. A patch copies only the block holding the slot when
+// a pinned version still shares it
+using ArcWeights = CowArray<double>;
+
 class Graph{
 public:
-    std::unordered_map<int , Node>nodes;//Access node via node id
-    std::unordered_map<int , Edge> edges;// Access edge via edge id
-    std::unordered_set<Edge , EdgeHash> edgeList;
-    std::unordered_map<int , std::unordered_set<Edge, EdgeHash>> adjList;
-
-    // constructor
-    Graph(std::vector<Node>& nodes , std::vector<Edge>& edges){
-        nodes.clear();
-        edgeList.clear();
-        adjList.clear();
-
-        for(Node& node : nodes){
-            this->nodes[node.id] = node;
-        }
-
-        for(Edge&edge : edges){
-            this->edges[edge.id] = edge;
-            edgeList.insert(edge);
-            adjList[edge.u].insert(edge);
-
-            if(!edge.oneway){
-                Edge rev = edge.Reverse();
-                adjList[rev.u].insert(rev);
-                edgeList.insert(rev);
+    // Every member is copy-on-write (cow.hpp): copying a graph is cheap, and the
+    // copy keeps seeing its own version while this one is updated (snapshot()).
+    // Reads index them like the plain containers, writes go through write().
+    // Members an update patches are split into blocks so it copies only those
+
+    // Nodes live at dense indices 0..n-1, node ids are only used at the query boundary
+    Cow<std::vector<Node>> nodes;// Access node via dense index
+    Cow<std::unordered_map<int , int>> nodeIndex;// node id -> dense index
+    // Edges live at dense indices too; arcs refer to them by index, so this is
+    // the only copy of each edge and a patch here is what every reader sees
+    CowArray<Edge , 64> edges;// Access edge via dense index
+    Cow<std::unordered_map<int , int>> edgeIndex;// edge id -> dense index
+
+    // Interned edge attributes, only ever appended to so ids stay valid
+    Cow<std::vector<std::string>> roadTypes;// road type id -> name
+    Cow<std::vector<std::string>> poiTags;// POI tag id -> name
+    Cow<std::unordered_map<std::string , int>> poiTagIndex;// name -> POI tag id
+    Cow<std::vector<std::vector<int>>> poiNodes;// POI tag id -> ascending dense indices of the nodes with it
+    CowArray<double> profileValues;// speed profiles back to back, none crossing a block
+
+    // Frozen CSR adjacency over dense node indices.
+    // Arcs leaving dense node i are the slots offsets[i] .. offsets[i+1]-1
+    Cow<std::vector<int>> offsets;
+    Cow<std::vector<int>> arcTarget;// dense index of the arc head
+    ArcWeights arcLength;// patched one block at a time by modify_edge
+    ArcWeights arcTime;
+    Cow<std::vector<int>> arcEdge;// dense index of the edge the arc was built from
+    CowArray<TtfRef> arcTtf;// travel-time function, shared by both slots of an edge
+    CowArray<TtfPoint> ttfPoints;// all functions back to back, none crossing a block
+    CowArray<std::pair<int , int>> edgeArcs;// dense edge index -> (forward slot , reverse slot), -1 if absent
+
+    // Reverse CSR: arcs entering dense node i are revOffsets[i] .. revOffsets[i+1]-1.
+    // Each entry points at the forward slot, so weight patches and removals show up in both
+    Cow<std::vector<int>> revOffsets;
+    Cow<std::vector<int>> revSource;// dense index of the arc tail
+    Cow<std::vector<int>> revArc;// forward slot of the arc
+
+    // Bumped whenever arc weights or the arc set change, preprocessed
+    // structures compare it to know whether they still describe this graph
+    uint64_t version = 0;
+    uint64_t layout = 0;// bumped when buildCSR reassigns arc slots
+
+    // Called with the edge id after its arcs changed (weights, removal or direction)
+    std::vector<std::function<void(int)>> edgeListeners;
+
+    Graph() {}
+
+    // Immutable copy of the current version for readers. It shares every member
+    // with this graph until an update here writes to one; listeners stay behind
+    std::shared_ptr<const Graph> snapshot() const{
+        auto copy = std::make_shared<Graph>(*this);
+        copy->edgeListeners.clear();
+        return copy;
+    }
+
+    int numNodes() const{
+        return (int)nodes.size();
+    }
+
+    // Dense index of a node id, -1 if the graph has no such node
+    int index(int id) const{
+        auto it = nodeIndex.find(id);
+        return it == nodeIndex.end() ? -1 : it->second;
+    }
+
+    // Whether any arc still in use leaves or enters the node at dense index i.
+    // Removed edges keep their slots with infinite weights, so those do not count
+    bool routable(int i) const{
+        for(int a = offsets[i]; a < offsets[i + 1]; a++){
+            if(std::isfinite(arcLength[a])) return true;
+        }
+        for(int k = revOffsets[i]; k < revOffsets[i + 1]; k++){
+            if(std::isfinite(arcLength[revArc[k]])) return true;
+        }
+        return false;
+    }
+
+    // Dense index of an edge id, -1 if the graph has no such edge
+    int edgeSlot(int id) const{
+        auto it = edgeIndex.find(id);
+        return it == edgeIndex.end() ? -1 : it->second;
+    }
+
+    // The edge with this id, nullptr if there is none
+    const Edge* edge(int id) const{
+        int e = edgeSlot(id);
+        return e < 0 ? nullptr : &edges[e];
+    }
+
+    // Id of a road type name, -1 if no edge ever had it
+    int roadTypeId(const std::string& name) const{
+        for(size_t i = 0; i < roadTypes.size(); i++){
+            if(roadTypes[i] == name) return (int)i;
+        }
+        return -1;
+    }
+
+    // Whether a constrained search may relax arc a: its edge's road type is not forbidden.
+    // Every search goes through here, forbidden nodes are blocked in the workspace
+    bool arcAllowed(int a , const RoadTypeMask& forbidden) const{
+        return forbidden.none() || !forbidden.test(edges[arcEdge[a]].roadType);
+    }
+
+    // Id of a road type name, added if new; -1 once MAX_ROAD_TYPES are taken
+    int internRoadType(const std::string& name){
+        int id = roadTypeId(name);
+        if(id >= 0 || (int)roadTypes.size() >= MAX_ROAD_TYPES) return id;
+        roadTypes.write().push_back(name);
+        return (int)roadTypes.size() - 1;
+    }
+
+    // Id of a POI tag, -1 if no node ever had it
+    int poiTagId(const std::string& name) const{
+        auto it = poiTagIndex.find(name);
+        return it == poiTagIndex.end() ? -1 : it->second;
+    }
+
+    // Id of a POI tag, added if new
+    int internPoiTag(const std::string& name){
+        int id = poiTagId(name);
+        if(id >= 0) return id;
+        id = (int)poiTags.size();
+        poiTags.write().push_back(name);
+        poiTagIndex.write()[name] = id;
+        poiNodes.write().emplace_back();
+        return id;
+    }
+
+    // Whether the node at dense index i carries the POI tag; nodes have few tags
+    bool hasPoi(int i , int tag) const{
+        const std::vector<int>& pois = nodes[i].pois;
+        return std::find(pois.begin() , pois.end() , tag) != pois.end();
+    }
+
+    // Speeds of a stored profile, profile.count of them
+    const double* speeds(ProfileRef profile) const{
+        return profile.count ? profileValues.run(profile.begin) : nullptr;
+    }
+
+    // Profiles hold one speed per bucket, a single speed when flat, or none
+    // for an edge that drives at its average_time all day
+    static bool validProfile(size_t values){
+        return values == 0 || values == 1 || values == SPEED_PROFILE_VALUES;
+    }
+
+    // Stored copy of a speed profile, shared with every identical one in index.
+    // Only loaders dedup. Callers check validProfile first; the pool only holds runs that size
+    ProfileRef internProfile(const std::vector<double>& speed , ProfileIndex& index){
+        bool constant = true;
+        for(double sp : speed){
+            if(sp != speed[0]) constant = false;
+        }
+        int count = constant ? std::min((int)speed.size() , 1) : (int)speed.size();
+
+        // FNV-1a over the bits of the speeds
+        uint64_t hash = 1469598103934665603ull;
+        for(int j = 0; j < count; j++){
+            uint64_t bits;
+            std::memcpy(&bits , &speed[j] , sizeof bits);
+            hash = (hash ^ bits) * 1099511628211ull;
+        }
+        auto range = index.equal_range(hash);
+        for(auto it = range.first; it != range.second; ++it){
+            ProfileRef ref = it->second;
+            if(ref.count == count && std::equal(speed.begin() , speed.begin() + count , speeds(ref))){
+                return ref;
             }
         }
-        
+        ProfileRef ref = {count ? (int)profileValues.appendRun(count) : 0 , count , false};
+        if(count) std::copy(speed.begin() , speed.begin() + count , profileValues.writeRun(ref.begin));
+        index.insert({hash , ref});
+        return ref;
     }
 
+    // Puts a full speed profile into e's own run, taken on its first patch and
+    // overwritten after that. A patch copies one block of profileValues at most,
+    // and the pool never grows past one run per patched edge
+    void patchProfile(Edge& e , const std::vector<double>& speed){
+        if(!e.profile.owned){
+            e.profile = {(int)profileValues.appendRun(SPEED_PROFILE_VALUES) , SPEED_PROFILE_VALUES , true};
+        }
+        std::copy(speed.begin() , speed.end() , profileValues.writeRun(e.profile.begin));
+    }
+
+    // Stores e under its id, replacing an edge with the same id in place.
+    // Arcs are not touched; buildCSR picks the edge up
+    int putEdge(const Edge& e){
+        int slot = edgeSlot(e.id);
+        if(slot < 0){
+            slot = (int)edges.size();
+            edgeIndex.write()[e.id] = slot;
+            edges.resize(slot + 1);
+        }
+        edges.write(slot) = e;
+        return slot;
+    }
+
+    // Rebuilds the packed adjacency from the edge list (counting sort on the arc tail)
+    void buildCSR(){
+        int n = numNodes();
+        std::vector<int>& offsets = this->offsets.write();
+        std::vector<int>& arcTarget = this->arcTarget.write();
+        std::vector<int>& arcEdge = this->arcEdge.write();
+        offsets.assign(n + 1, 0);
+
+        auto usable = [&](const Edge& e){
+            return !e.removed && nodeIndex.count(e.u) && nodeIndex.count(e.v);
+        };
+
+        int edgeCount = (int)edges.size();
+        for(int i = 0; i < edgeCount; i++){
+            const Edge& e = edges[i];
+            if(!usable(e)) continue;
+            offsets[nodeIndex.at(e.u) + 1]++;
+            if(!e.oneway) offsets[nodeIndex.at(e.v) + 1]++;
+        }
+        for(int i = 0; i < n; i++){
+            offsets[i + 1] += offsets[i];
+        }
+
+        int m = offsets[n];
+        arcTarget.assign(m, 0);
+        arcEdge.assign(m, 0);
+
+        std::vector<int> next(offsets.begin(), offsets.end() - 1);
+        for(int i = 0; i < edgeCount; i++){
+            const Edge& e = edges[i];
+            if(!usable(e)) continue;
+            int u = nodeIndex.at(e.u) , v = nodeIndex.at(e.v);
+            int slot = next[u]++;
+            arcTarget[slot] = v;
+            arcEdge[slot] = i;
+            if(e.oneway) continue;
+            slot = next[v]++;
+            arcTarget[slot] = u;
+            arcEdge[slot] = i;
+        }
+
+        // Incoming arcs, bucketed by head in the same way
+        std::vector<int>& revOffsets = this->revOffsets.write();
+        std::vector<int>& revSource = this->revSource.write();
+        std::vector<int>& revArc = this->revArc.write();
+        revOffsets.assign(n + 1, 0);
+        for(int a = 0; a < m; a++){
+            revOffsets[arcTarget[a] + 1]++;
+        }
+        for(int i = 0; i < n; i++){
+            revOffsets[i + 1] += revOffsets[i];
+        }
+        revSource.assign(m, 0);
+        revArc.assign(m, 0);
+        next.assign(revOffsets.begin(), revOffsets.end() - 1);
+        for(int u = 0; u < n; u++){
+            for(int a = offsets[u]; a < offsets[u + 1]; a++){
+                int slot = next[arcTarget[a]]++;
+                revSource[slot] = u;
+                revArc[slot] = a;
+            }
+        }
+        indexArcs();
+    }
+
+    // Fills the per-arc weights, travel-time functions and edgeArcs from
+    // offsets / arcTarget / arcEdge, which buildCSR or a snapshot provide.
+    // Arcs of removed edges keep their slot with infinite weights
+    void indexArcs(){
+        version++;
+        layout++;
+        int m = (int)arcTarget.size();
+        arcLength.assign(m, 0.0);
+        arcTime.assign(m, 0.0);
+        arcTtf.assign(m, {0 , 0 , 0 , 0});
+        ttfPoints.clear();
+        edgeArcs.assign(edges.size() , {-1 , -1});
+
+        for(int u = 0; u < numNodes(); u++){
+            for(int a = offsets[u]; a < offsets[u + 1]; a++){
+                const Edge& e = edges[arcEdge[a]];
+                if(e.removed){
+                    arcLength.write(a) = std::numeric_limits<double>::infinity();
+                    arcTime.write(a) = std::numeric_limits<double>::infinity();
+                    continue;
+                }
+                arcLength.write(a) = e.length;
+                arcTime.write(a) = e.average_time;
+
+                // The slot running u -> v is the forward one, a second slot is the reverse
+                std::pair<int , int>& slots = edgeArcs.write(arcEdge[a]);
+                bool forward = slots.first < 0 && nodes[u].id == e.u && nodes[arcTarget[a]].id == e.v;
+                if(forward){
+                    slots.first = a;
+                    arcTtf.write(a) = buildTtf(e , {0 , 0 , 0 , 0});
+                } else {
+                    slots.second = a;
+                }
+            }
+        }
+        for(size_t i = 0; i < edgeArcs.size(); i++){
+            const std::pair<int , int>& slots = edgeArcs[i];
+            if(slots.first >= 0 && slots.second >= 0) arcTtf.write(slots.second) = arcTtf[slots.first];
+        }
+    }
+
+    // Precomputes e's travel-time function, reusing the slice `old` when the size fits.
+    // A constant profile is stored as one speed, so it needs a single point; an
+    // edge without a profile takes its average_time, whatever the patches make it
+    TtfRef buildTtf(const Edge& e , TtfRef old){
+        const double* speed = speeds(e.profile);
+        int count = std::max(e.profile.count , 1);
+
+        TtfRef ref = old;
+        if(old.count != count){
+            ref = {(int)ttfPoints.appendRun(count) , count , 0 , 0};
+        }
+        TtfPoint* p = ttfPoints.writeRun(ref.begin);
+        if(!speed){
+            p[0] = {e.average_time , e.average_time};
+            ref.lo = ref.hi = e.average_time;
+            return ref;
+        }
+        for(int j = 0; j < count; j++){
+            p[j].raw = e.length / speed[j];
+            p[j].closed = p[j].raw;
+        }
+
+        // Waiting one bucket costs its width; sweep backwards twice to wrap past midnight
+        double width = DAY_SECONDS / count;
+        for(int j = 2 * count - 2; j >= 0; j--){
+            TtfPoint& cur = p[j % count];
+            cur.closed = std::min(cur.closed , p[(j + 1) % count].closed + width);
+        }
+        ref.lo = p[0].closed;
+        ref.hi = p[0].raw;
+        for(int j = 1; j < count; j++){
+            ref.lo = std::min(ref.lo , p[j].closed);
+            ref.hi = std::max(ref.hi , p[j].raw);
+        }
+        return ref;
+    }
+
+    // node.pois must hold ids from this graph's poiTags
     void addNode(const Node& node){
-        nodes[node.id] = node;
+        auto it = nodeIndex.find(node.id);
+        if(it != nodeIndex.end()){
+            indexPois(it->second , nodes[it->second].pois , false);
+            nodes.write()[it->second] = node;
+            indexPois(it->second , node.pois , true);
+            return;
+        }
+
+        // New nodes get the next dense index with an empty arc range
+        nodeIndex.write()[node.id] = numNodes();
+        nodes.write().push_back(node);
+        indexPois(numNodes() - 1 , node.pois , true);
+        std::vector<int>& offsets = this->offsets.write();
+        if(offsets.empty()) offsets.push_back(0);
+        offsets.push_back(offsets.back());
+        std::vector<int>& revOffsets = this->revOffsets.write();
+        if(revOffsets.empty()) revOffsets.push_back(0);
+        revOffsets.push_back(revOffsets.back());
     }
 
-    void addEdge(const Edge&e){
-        edgeList.insert(e);
-        adjList[e.u].insert(e); 
-        
+    // Adds node i to, or drops it from, the poiNodes list of each distinct tag
+    void indexPois(int i , const std::vector<int>& tags , bool add){
+        std::vector<std::vector<int>>& lists = poiNodes.write();
+        for(size_t j = 0; j < tags.size(); j++){
+            if(std::find(tags.begin() , tags.begin() + j , tags[j]) != tags.begin() + j) continue;
+            std::vector<int>& list = lists[tags[j]];
+            auto pos = std::lower_bound(list.begin() , list.end() , i);
+            if(add && (pos == list.end() || *pos != i)) list.insert(pos , i);
+            if(!add && pos != list.end() && *pos == i) list.erase(pos);
+        }
+    }
 
-        // If not oneway add reverse edge also
-        if(!e.oneway){
-            Edge rev = e.Reverse();
-            adjList[rev.u].insert(rev);
-            edgeList.insert(rev);
-        }  
+    void addEdge(const Edge&e){
+        putEdge(e);
+        buildCSR();
+        notifyEdge(e.id);
     }
 
-    void removeEdge(const Edge&e){
-        adjList[e.u].erase(e);
-        edgeList.erase(e);
+    void removeEdge(int id){
+        int i = edgeSlot(id);
+        if(i < 0 || edges[i].removed) return;
+        edges.write(i).removed = true;
+        version++;
 
-        // If not oneway we should also remove reverse edges
-        if(!e.oneway){
-            Edge rev = e.Reverse();
-            adjList[rev.u].erase(rev);
-            edgeList.erase(rev);
+        // The arc slots stay in place but can never be relaxed again
+        std::pair<int , int> slots = edgeArcs[i];
+        if(slots.first < 0) return;
+        for(int slot : {slots.first , slots.second}){
+            if(slot < 0) continue;
+            arcLength.write(slot) = std::numeric_limits<double>::infinity();
+            arcTime.write(slot) = std::numeric_limits<double>::infinity();
         }
+        edgeArcs.write(i) = {-1 , -1};
+        notifyEdge(id);
     }
 
     void modifyEdge(int id , const json& patch){
-        Edge& e = edges[id];
+        int i = edgeSlot(id);
+        if(i < 0) return;
+        Edge& e = edges.write(i);
+        bool oneway = e.oneway;
         if(patch.contains("length")) e.length = patch["length"];
         if(patch.contains("average_time")) e.average_time = patch["average_time"];
         if(patch.contains("oneway")) e.oneway = patch["oneway"];
-        if(patch.contains("road_type")) e.road_type = patch["road_type"];
+        if(patch.contains("road_type")){
+            int type = internRoadType(patch["road_type"]);
+            if(type >= 0) e.roadType = (uint8_t)type;
+            else std::cerr << "Too many road types, road_type patch of edge " << id << " ignored\n";
+        }
         if (patch.contains("speed_profile")) {
-            e.speed_profile = patch["speed_profile"].get<std::vector<double>>();
+            std::vector<double> speed = patch["speed_profile"].get<std::vector<double>>();
+            if(speed.size() == (size_t)SPEED_PROFILE_VALUES) patchProfile(e , speed);
+            else std::cerr << "Speed profile must have 96 values, speed_profile patch of edge " << id << " ignored\n";
         }
-    }
-
-};
+        if(e.removed) return;
 
+        // Travel-time functions depend on length and the profile. The edge's run
+        // is rewritten in place and only moves once, when a flat profile is
+        // patched to a full one, so a patch copies a few blocks at most
+        std::pair<int , int> slots = edgeArcs[i];
+        if(slots.first >= 0 && e.oneway == oneway &&
+           (patch.contains("speed_profile") || patch.contains("length") || patch.contains("average_time"))){
+            int fwd = slots.first , rev = slots.second;
+            TtfRef ref = buildTtf(e , arcTtf[fwd]);
+            arcTtf.write(fwd) = ref;
+            if(rev >= 0) arcTtf.write(rev) = ref;
+        }
+        if(!patch.contains("length") && !patch.contains("average_time") && e.oneway == oneway) return;
 
+        // Changing direction changes the arc set, weights are patched in place;
+        // a pinned version only costs a copy of the blocks holding the slots
+        if(e.oneway != oneway){
+            buildCSR();
+            notifyEdge(id);
+            return;
+        }
+        version++;
+        if(slots.first < 0) return;
+        for(int slot : {slots.first , slots.second}){
+            if(slot < 0) continue;
+            arcLength.write(slot) = e.length;
+            arcTime.write(slot) = e.average_time;
+        }
+        notifyEdge(id);
+    }
 
+    void notifyEdge(int id){
+        for(auto& listener : edgeListeners){
+            listener(id);
+        }
+    }
 
+};
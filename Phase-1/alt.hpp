@@ -0,0 +1,268 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <queue>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <unordered_map>
+#include "Graph.hpp"
+
+// ALT (A*, landmarks, triangle inequality). Exact distances to and from a few
+// landmarks bound the distance between any two nodes for both metrics:
+//   d(v,t) >= d(v,L) - d(t,L)   and   d(v,t) >= d(L,t) - d(L,v)
+// Bounds survive edge removals and weight increases; a weight that drops below
+// its preprocessed value switches that metric off for the rest of the run, as
+// landmark distances are never recomputed.
+class Landmarks {
+public:
+    int n = 0;
+    int count = 0;
+    std::vector<int> landmarks;// dense indices
+
+    // Node-major, [v * count + l]: all landmarks of a node share cache lines.
+    // Stored as float rounded down, lowerBound() allows for the rounding
+    std::vector<float> toLandmark[2];// d(v, L), metric 0 distance, 1 time
+    std::vector<float> fromLandmark[2];// d(L, v)
+
+    Landmarks(Graph& graph, int wanted = 16) : graph(graph) {
+        build(wanted);
+        graph.edgeListeners.push_back([this](int id) { edgeChanged(id); });
+    }
+
+    Landmarks(const Landmarks&) = delete;
+    Landmarks& operator=(const Landmarks&) = delete;
+
+    static int metric_of(const std::string& mode) { return mode == "distance" ? 0 : 1; }
+
+    bool usable(int metric) const { return valid[metric] && count > 0; }
+
+    // Lower bound on d(v, t) from the landmarks listed in active, or from all of
+    // them when active is null; 0 for nodes added after preprocessing
+    double lowerBound(int metric, int v, int t, const int* active = nullptr, int k = 0) const {
+        if (v >= n || t >= n) return 0.0;
+        const float* tv = toLandmark[metric].data() + (size_t)v * count;
+        const float* tt = toLandmark[metric].data() + (size_t)t * count;
+        const float* fv = fromLandmark[metric].data() + (size_t)v * count;
+        const float* ft = fromLandmark[metric].data() + (size_t)t * count;
+        if (!active) k = count;
+
+        // A stored value may be up to one float ulp below the true distance,
+        // so the subtracted side is scaled up by that much. Unreached pairs say nothing
+        const double slack = 1.0 + FLT_EPSILON;
+        double best = 0.0;
+        for (int i = 0; i < k; i++) {
+            int l = active ? active[i] : i;
+            if (std::isfinite(tv[l]) && std::isfinite(tt[l]))
+                best = std::max(best, tv[l] - tt[l] * slack);
+            if (std::isfinite(ft[l]) && std::isfinite(fv[l]))
+                best = std::max(best, ft[l] - fv[l] * slack);
+        }
+        return best;
+    }
+
+    // Most landmarks select() picks for one query
+    static constexpr int MAX_ACTIVE = 8;
+
+    // The k landmarks giving the best bound on d(s, t), best first. A query
+    // only evaluates these, which keeps each bound to a few loads. Ranked by
+    // insertion into the caller's array, so no query allocates
+    int select(int metric, int s, int t, int* active, int k) const {
+        if (s >= n || t >= n) return 0;
+        k = std::min({k, count, MAX_ACTIVE});
+        std::pair<double, int> ranked[MAX_ACTIVE];
+        int kept = 0;
+        for (int l = 0; l < count; l++) {
+            std::pair<double, int> item = {lowerBound(metric, s, t, &l, 1), l};
+            if (kept == k && !(item > ranked[k - 1])) continue;
+            int i = (kept < k) ? kept++ : k - 1;
+            for (; i > 0 && item > ranked[i - 1]; i--)
+                ranked[i] = ranked[i - 1];
+            ranked[i] = item;
+        }
+        for (int i = 0; i < k; i++)
+            active[i] = ranked[i].second;
+        return k;
+    }
+
+private:
+    struct Weights {
+        double length, time;
+        bool oneway;
+    };
+
+    Graph& graph;
+    std::atomic<bool> valid[2] = {true, true};// read by queries on other threads
+    std::unordered_map<int, Weights> builtWeights;// edge id -> weights at preprocessing
+
+    const ArcWeights& weights(int metric) const {
+        return metric == 0 ? graph.arcLength : graph.arcTime;
+    }
+
+    // One-to-all Dijkstra over the forward or reverse CSR. order, if given, gets
+    // the nodes in settle order, so parents come before their children
+    void sweep(int from, bool backward, int metric, std::vector<double>& dist,
+               std::vector<int>* parent, std::vector<int>* order) const {
+        const ArcWeights& w = weights(metric);
+        dist.assign(n, std::numeric_limits<double>::infinity());
+        if (parent) parent->assign(n, -1);
+        if (order) order->clear();
+
+        using Item = std::pair<double, int>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> pq;
+        dist[from] = 0.0;
+        pq.push({0.0, from});
+        while (!pq.empty()) {
+            auto [d, u] = pq.top();
+            pq.pop();
+            if (d > dist[u]) continue;
+            if (order) order->push_back(u);
+
+            const std::vector<int>& offsets = backward ? graph.revOffsets : graph.offsets;
+            for (int k = offsets[u]; k < offsets[u + 1]; k++) {
+                int a = backward ? graph.revArc[k] : k;
+                int v = backward ? graph.revSource[k] : graph.arcTarget[k];
+                double nd = d + w[a];
+                if (nd < dist[v]) {
+                    dist[v] = nd;
+                    if (parent) (*parent)[v] = u;
+                    pq.push({nd, v});
+                }
+            }
+        }
+    }
+
+    void addLandmark(int v) {
+        int l = (int)landmarks.size();
+        landmarks.push_back(v);
+        std::vector<double> dist;
+        for (int metric = 0; metric < 2; metric++) {
+            for (bool backward : {false, true}) {
+                sweep(v, backward, metric, dist, nullptr, nullptr);
+                std::vector<float>& out = backward ? toLandmark[metric] : fromLandmark[metric];
+                for (int u = 0; u < n; u++) {
+                    float f = (float)dist[u];
+                    if (f > dist[u]) f = std::nextafter(f, 0.0f);
+                    out[(size_t)u * count + l] = f;
+                }
+            }
+        }
+    }
+
+    // Farthest node from an arbitrary start first, then "avoid": grow a shortest
+    // path tree from a random root, weigh each node by how much the current
+    // landmarks underestimate its distance, and walk down the heaviest subtree
+    // without a landmark to its leaf
+    void build(int wanted) {
+        n = graph.numNodes();
+        count = std::min(wanted, n);
+        landmarks.clear();
+        for (int metric = 0; metric < 2; metric++) {
+            toLandmark[metric].assign((size_t)n * count, std::numeric_limits<float>::infinity());
+            fromLandmark[metric].assign((size_t)n * count, std::numeric_limits<float>::infinity());
+        }
+        builtWeights.clear();
+        for (size_t i = 0; i < graph.edges.size(); i++) {
+            const Edge& e = graph.edges[i];
+            if (!e.removed)
+                builtWeights[e.id] = {e.length, e.average_time, e.oneway};
+        }
+        if (count == 0) return;
+
+        std::mt19937 rng(12345);
+        std::vector<double> dist;
+        std::vector<int> parent, order;
+        std::vector<char> isLandmark(n, 0);
+        auto farthest = [&]() {
+            int best = -1;
+            for (int v : order) {
+                if (!isLandmark[v] && (best < 0 || dist[v] > dist[best]))
+                    best = v;
+            }
+            return best;
+        };
+
+        // lowerBound reads every slot, so it only sees the landmarks placed so far
+        const int total = count;
+        sweep(0, false, 0, dist, nullptr, &order);
+        int first = farthest();
+        addLandmark(first < 0 ? 0 : first);
+        isLandmark[landmarks.back()] = 1;
+
+        std::vector<double> size(n);
+        std::vector<char> covered(n);
+        std::vector<int> childOffsets(n + 1), children;
+        while ((int)landmarks.size() < total) {
+            int root = std::uniform_int_distribution<int>(0, n - 1)(rng);
+            sweep(root, false, 0, dist, &parent, &order);
+
+            // Children always settle after their parent, so a reverse pass sees them first
+            std::fill(size.begin(), size.end(), 0.0);
+            std::fill(covered.begin(), covered.end(), 0);
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                int v = *it;
+                if (isLandmark[v]) covered[v] = 1;
+                size[v] = covered[v] ? 0.0 : size[v] + dist[v] - lowerBound(0, root, v);
+                int p = parent[v];
+                if (p >= 0) {
+                    covered[p] |= covered[v];
+                    size[p] += size[v];
+                }
+            }
+
+            std::fill(childOffsets.begin(), childOffsets.end(), 0);
+            for (int v : order)
+                if (parent[v] >= 0) childOffsets[parent[v] + 1]++;
+            for (int v = 0; v < n; v++)
+                childOffsets[v + 1] += childOffsets[v];
+            children.assign(childOffsets[n], 0);
+            std::vector<int> pos(childOffsets.begin(), childOffsets.end() - 1);
+            for (int v : order)
+                if (parent[v] >= 0) children[pos[parent[v]]++] = v;
+
+            int pick = -1;
+            if (!covered[root] && size[root] > 0) {
+                int v = root;
+                while (true) {
+                    int next = -1;
+                    for (int c = childOffsets[v]; c < childOffsets[v + 1]; c++) {
+                        int child = children[c];
+                        if (!covered[child] && (next < 0 || size[child] > size[next]))
+                            next = child;
+                    }
+                    if (next < 0) break;
+                    v = next;
+                }
+                pick = v;
+            }
+            // Every branch already holds a landmark: fall back to the farthest node
+            if (pick < 0 || isLandmark[pick])
+                pick = farthest();
+            if (pick < 0) {
+                // The root reaches only landmarks; any other node will do
+                for (int v = 0; v < n && pick < 0; v++)
+                    if (!isLandmark[v]) pick = v;
+            }
+            addLandmark(pick);
+            isLandmark[pick] = 1;
+        }
+    }
+
+    // Lower weights than at preprocessing would make the bounds overestimate
+    void edgeChanged(int id) {
+        const Edge& e = *graph.edge(id);
+        if (e.removed) return;
+        auto it = builtWeights.find(id);
+        if (it == builtWeights.end() || (it->second.oneway && !e.oneway)) {
+            valid[0] = valid[1] = false;
+            return;
+        }
+        if (e.length < it->second.length) valid[0] = false;
+        if (e.average_time < it->second.time) valid[1] = false;
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include "Graph.hpp"
+#include "ch.hpp"
+#include "workspace.hpp"
+
+// Bucket-based kNN on the distance hierarchy. Every POI runs one backward
+// upward search at preprocessing and leaves (distance, POI) in the bucket of
+// each node it settles, so d(x, p) is there for every x on p's side of a
+// shortest up-down path. A query is then a single forward upward search from
+// the source that scans the buckets of the nodes it settles: the best
+// d(s, x) + d(x, p) over them is d(s, p).
+//
+// Memory grows with POIs times search space, and Dijkstra already meets k
+// POIs of a common tag within a few steps, so only tags on at most MAX_POIS
+// nodes get buckets. They describe the weights the hierarchy was built from
+// and go stale with it after the first edge update; nothing rebuilds them.
+class PoiBuckets {
+public:
+    static constexpr size_t MAX_POIS = 1024;
+
+    PoiBuckets(const Graph& graph, const ContractionHierarchy& ch) : ch(ch), n(graph.numNodes()) {
+        const std::vector<std::vector<int>>& lists = graph.poiNodes;
+        tags.resize(lists.size());
+        SearchWorkspace::Side search;
+        std::vector<std::pair<int, double>> space;
+        for (size_t tag = 0; tag < lists.size(); tag++) {
+            if (lists[tag].size() > MAX_POIS) continue;
+            tags[tag].built = true;
+            std::vector<Entry> entries;
+            for (int p : lists[tag]) {
+                upward(search, p, ch.backwardOffsets, ch.backwardArcs, ch.forwardOffsets, ch.forwardArcs, space);
+                for (auto& [x, d] : space)
+                    entries.push_back({x, d, p});
+            }
+            pack(tags[tag], entries);
+        }
+    }
+
+    PoiBuckets(const PoiBuckets&) = delete;
+    PoiBuckets& operator=(const PoiBuckets&) = delete;
+
+    bool current(const Graph& graph) const {
+        return n == graph.numNodes() && ch.current(graph) && tags.size() == graph.poiTags.size();
+    }
+
+    // Whether tag was sparse enough to get buckets
+    bool covers(int tag) const { return tag >= 0 && tag < (int)tags.size() && tags[tag].built; }
+
+    // Dense indices of the k POIs with tag nearest to source by road distance,
+    // nearest first, ties by index like knn_shortest_path. tag must be covered
+    std::vector<int> nearest(SearchWorkspace& ws, int source, int tag, int k) const {
+        if (source < 0 || source >= n || !covers(tag) || k <= 0)
+            return {};
+        const Buckets& b = tags[tag];
+
+        // Settled in order of distance, so the bucket scan below can stop early
+        std::vector<std::pair<int, double>> space;
+        upward(ws.forward, source, ch.forwardOffsets, ch.forwardArcs, ch.backwardOffsets, ch.backwardArcs, space);
+
+        // Best distance per POI so far lives in the backward labels
+        SearchWorkspace::Side& best = ws.backward;
+        best.reset(n);
+        std::vector<int> found;
+        std::vector<double> kth;
+        double bound = std::numeric_limits<double>::infinity();
+        for (auto& [x, d] : space) {
+            if (d > bound) break;
+            auto it = std::lower_bound(b.nodes.begin(), b.nodes.end(), x);
+            if (it == b.nodes.end() || *it != x) continue;
+            size_t i = it - b.nodes.begin();
+            for (int e = b.begin[i]; e < b.begin[i + 1]; e++) {
+                double via = d + b.dist[e];
+                if (via > bound) break;
+                int p = b.poi[e];
+                if (!best.reached(p)) found.push_back(p);
+                if (via < best.distance(p)) best.label(p, via, x);
+            }
+            // Minima only drop, so the k-th smallest so far bounds the answer
+            if ((int)found.size() >= k) {
+                kth.clear();
+                for (int p : found) kth.push_back(best.distance(p));
+                std::nth_element(kth.begin(), kth.begin() + (k - 1), kth.end());
+                bound = kth[k - 1];
+            }
+        }
+
+        std::vector<std::pair<double, int>> ranked;
+        ranked.reserve(found.size());
+        for (int p : found)
+            ranked.push_back({best.distance(p), p});
+        int count = std::min(k, (int)ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+        std::vector<int> result;
+        for (int i = 0; i < count; i++)
+            result.push_back(ranked[i].second);
+        return result;
+    }
+
+private:
+    struct Entry {
+        int node;
+        double dist;
+        int poi;
+    };
+
+    // One tag's buckets: nodes ascending, entries of nodes[i] are
+    // [begin[i], begin[i + 1]) in dist / poi, nearest first
+    struct Buckets {
+        bool built = false;// tags over MAX_POIS stay empty
+        std::vector<int> nodes;
+        std::vector<int> begin;
+        std::vector<double> dist;
+        std::vector<int> poi;
+    };
+
+    const ContractionHierarchy& ch;
+    int n;
+    std::vector<Buckets> tags;// POI tag id -> buckets
+
+    using UpArc = ContractionHierarchy::UpArc;
+
+    // Upward Dijkstra with stall-on-demand like ContractionHierarchy::query;
+    // space gets the settled, unstalled nodes in order with their distances
+    static void upward(SearchWorkspace::Side& search, int from,
+                       const std::vector<int>& offsets, const std::vector<UpArc>& arcs,
+                       const std::vector<int>& opp_offsets, const std::vector<UpArc>& opp_arcs,
+                       std::vector<std::pair<int, double>>& space) {
+        space.clear();
+        search.reset((int)offsets.size() - 1);
+        search.label(from, 0.0, -1);
+        search.push(0.0, from);
+        while (!search.empty()) {
+            auto [d, u] = search.pop();
+            if (search.settled(u)) continue;
+            search.settle(u);
+
+            bool stalled = false;
+            for (int a = opp_offsets[u]; a < opp_offsets[u + 1] && !stalled; a++)
+                stalled = search.distance(opp_arcs[a].head) + opp_arcs[a].weight < d;
+            if (stalled) continue;
+            space.push_back({u, d});
+
+            for (int a = offsets[u]; a < offsets[u + 1]; a++) {
+                const UpArc& arc = arcs[a];
+                double nd = d + arc.weight;
+                if (nd < search.distance(arc.head)) {
+                    search.label(arc.head, nd, u);
+                    search.push(nd, arc.head);
+                }
+            }
+        }
+    }
+
+    static void pack(Buckets& b, std::vector<Entry>& entries) {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& c) {
+            return a.node != c.node ? a.node < c.node : a.dist < c.dist;
+        });
+        b.dist.reserve(entries.size());
+        b.poi.reserve(entries.size());
+        for (size_t e = 0; e < entries.size(); e++) {
+            if (e == 0 || entries[e].node != entries[e - 1].node) {
+                b.nodes.push_back(entries[e].node);
+                b.begin.push_back((int)e);
+            }
+            b.dist.push_back(entries[e].dist);
+            b.poi.push_back(entries[e].poi);
+        }
+        b.begin.push_back((int)entries.size());
+    }
+};
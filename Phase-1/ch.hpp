@@ -0,0 +1,460 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <functional>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+#include "workspace.hpp"
+
+// Contraction Hierarchies for one static metric (arcLength or arcTime).
+// Nodes are contracted in order of importance; the shortcuts that keep
+// distances intact form an upward graph that a bidirectional search can
+// answer queries on while only climbing in rank.
+class ContractionHierarchy {
+public:
+    // Arc to a higher ranked node. mid is the node a shortcut bypasses, -1 for graph arcs
+    struct UpArc {
+        int head;
+        int mid;
+        double weight;
+    };
+
+    int n = 0;
+    uint64_t fingerprint = 0;// weights the hierarchy was built from
+    uint64_t builtVersion = 0;// Graph::version the hierarchy matches
+    std::vector<int> rank;
+
+    // forward: arcs u -> head with rank[head] > rank[u], stored at u
+    // backward: arcs head -> u with rank[head] > rank[u], stored at u
+    std::vector<int> forwardOffsets, backwardOffsets;
+    std::vector<UpArc> forwardArcs, backwardArcs;
+
+    // Stale once the graph's weights or arcs changed after preprocessing
+    bool current(const Graph& graph) const {
+        return n == graph.numNodes() && builtVersion == graph.version;
+    }
+
+    static ContractionHierarchy build(const Graph& graph, const ArcWeights& weight);
+
+    PathResult query(SearchWorkspace& ws, int source, int target) const;
+
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+
+private:
+    const UpArc* findArc(int from, int to) const;
+    void unpack(int from, int to, std::vector<int>& path) const;
+};
+
+// FNV-1a over the node ids and every live arc of one metric, used to tell
+// whether a saved hierarchy still belongs to the loaded graph
+inline uint64_t graph_fingerprint(const Graph& graph, const ArcWeights& weight) {
+    uint64_t h = 1469598103934665603ULL;
+    auto mix = [&](const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; i++) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+    };
+    int n = graph.numNodes();
+    mix(&n, sizeof n);
+    for (int u = 0; u < n; u++) {
+        mix(&graph.nodes[u].id, sizeof(int));
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            double w = weight[a];
+            if (!std::isfinite(w)) continue;
+            mix(&graph.arcTarget[a], sizeof(int));
+            mix(&w, sizeof(double));
+        }
+    }
+    return h;
+}
+
+inline ContractionHierarchy ContractionHierarchy::build(const Graph& graph, const ArcWeights& weight) {
+    struct Link {
+        int node;
+        double weight;
+        int mid;
+    };
+
+    const int n = graph.numNodes();
+    std::vector<std::vector<Link>> out(n), in(n);
+
+    // Keeps a single (cheapest) link per ordered node pair
+    auto add_link = [&](int u, int v, double w, int mid) {
+        for (Link& l : out[u]) {
+            if (l.node != v) continue;
+            if (w < l.weight) {
+                l.weight = w;
+                l.mid = mid;
+                for (Link& r : in[v]) {
+                    if (r.node == u) {
+                        r.weight = w;
+                        r.mid = mid;
+                    }
+                }
+            }
+            return;
+        }
+        out[u].push_back({v, w, mid});
+        in[v].push_back({u, w, mid});
+    };
+
+    for (int u = 0; u < n; u++) {
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            if (u == v || !std::isfinite(weight[a])) continue;
+            add_link(u, v, weight[a], -1);
+        }
+    }
+
+    std::vector<char> contracted(n, 0);
+    std::vector<int> deleted_neighbors(n, 0);
+    std::vector<int> level(n, 0);
+    SearchWorkspace::Side witness;
+
+    // Bounded Dijkstra from u over uncontracted nodes, skipping v
+    const int settle_limit = 200;
+    auto witness_search = [&](int u, int v, double max_dist) {
+        witness.reset(n);
+        witness.label(u, 0.0, -1);
+        witness.push(0.0, u);
+        int settled = 0;
+        while (!witness.empty()) {
+            auto [d, x] = witness.pop();
+            if (witness.settled(x)) continue;
+            witness.settle(x);
+            if (d > max_dist || ++settled > settle_limit) break;
+            for (const Link& l : out[x]) {
+                if (l.node == v || contracted[l.node]) continue;
+                double nd = d + l.weight;
+                if (nd < witness.distance(l.node)) {
+                    witness.label(l.node, nd, x);
+                    witness.push(nd, l.node);
+                }
+            }
+        }
+    };
+
+    struct Shortcut {
+        int from, to;
+        double weight;
+    };
+
+    // Shortcuts needed to contract v, added to the graph unless simulating
+    auto contract = [&](int v, bool simulate) {
+        int shortcuts = 0;
+        std::vector<Shortcut> pending;
+        for (const Link& inl : in[v]) {
+            int u = inl.node;
+            if (contracted[u]) continue;
+            double max_dist = 0.0;
+            for (const Link& outl : out[v]) {
+                if (!contracted[outl.node] && outl.node != u)
+                    max_dist = std::max(max_dist, inl.weight + outl.weight);
+            }
+            if (max_dist == 0.0) continue;
+            witness_search(u, v, max_dist);
+            for (const Link& outl : out[v]) {
+                int w = outl.node;
+                if (contracted[w] || w == u) continue;
+                double via = inl.weight + outl.weight;
+                if (witness.distance(w) <= via) continue;
+                shortcuts++;
+                if (!simulate)
+                    pending.push_back({u, w, via});
+            }
+        }
+        for (const Shortcut& sc : pending)
+            add_link(sc.from, sc.to, sc.weight, v);
+        return shortcuts;
+    };
+
+    auto priority = [&](int v) {
+        int degree = 0;
+        for (const Link& l : out[v]) degree += !contracted[l.node];
+        for (const Link& l : in[v]) degree += !contracted[l.node];
+        return 2 * (contract(v, true) - degree) + deleted_neighbors[v] + level[v];
+    };
+
+    using PQ = std::pair<int, int>;
+    std::priority_queue<PQ, std::vector<PQ>, std::greater<PQ>> order;
+    for (int v = 0; v < n; v++)
+        order.push({priority(v), v});
+
+    ContractionHierarchy ch;
+    ch.n = n;
+    ch.rank.assign(n, 0);
+    std::vector<std::vector<UpArc>> up(n), down(n);
+
+    int next_rank = 0;
+    while (!order.empty()) {
+        auto [p, v] = order.top();
+        order.pop();
+        if (contracted[v]) continue;
+
+        // Lazy update: priorities go stale as neighbours get contracted
+        int fresh = priority(v);
+        if (!order.empty() && fresh > order.top().first) {
+            order.push({fresh, v});
+            continue;
+        }
+
+        // Everything still attached to v ranks higher than v
+        for (const Link& l : out[v])
+            if (!contracted[l.node]) up[v].push_back({l.node, l.mid, l.weight});
+        for (const Link& l : in[v])
+            if (!contracted[l.node]) down[v].push_back({l.node, l.mid, l.weight});
+
+        contract(v, false);
+        contracted[v] = 1;
+        ch.rank[v] = next_rank++;
+
+        for (const Link& l : out[v]) {
+            if (contracted[l.node]) continue;
+            deleted_neighbors[l.node]++;
+            level[l.node] = std::max(level[l.node], level[v] + 1);
+        }
+        for (const Link& l : in[v]) {
+            if (contracted[l.node]) continue;
+            deleted_neighbors[l.node]++;
+            level[l.node] = std::max(level[l.node], level[v] + 1);
+        }
+        std::vector<Link>().swap(out[v]);
+        std::vector<Link>().swap(in[v]);
+    }
+
+    auto flatten = [n](std::vector<std::vector<UpArc>>& lists, std::vector<int>& offsets, std::vector<UpArc>& arcs) {
+        offsets.assign(n + 1, 0);
+        for (int v = 0; v < n; v++)
+            offsets[v + 1] = offsets[v] + (int)lists[v].size();
+        arcs.clear();
+        arcs.reserve(offsets[n]);
+        for (auto& l : lists)
+            arcs.insert(arcs.end(), l.begin(), l.end());
+    };
+    flatten(up, ch.forwardOffsets, ch.forwardArcs);
+    flatten(down, ch.backwardOffsets, ch.backwardArcs);
+
+    ch.fingerprint = graph_fingerprint(graph, weight);
+    ch.builtVersion = graph.version;
+    return ch;
+}
+
+// Bidirectional upward Dijkstra with stall-on-demand, source/target are dense indices
+inline PathResult ContractionHierarchy::query(SearchWorkspace& ws, int source, int target) const {
+    if (source < 0 || source >= n || target < 0 || target >= n)
+        return {};
+
+    SearchWorkspace::Side& fwd = ws.forward;
+    SearchWorkspace::Side& bwd = ws.backward;
+    fwd.reset(n);
+    bwd.reset(n);
+    fwd.label(source, 0.0, -1);
+    fwd.push(0.0, source);
+    bwd.label(target, 0.0, -1);
+    bwd.push(0.0, target);
+
+    double best = std::numeric_limits<double>::infinity();
+    int meet = -1;
+
+    auto step = [&](SearchWorkspace::Side& self, const SearchWorkspace::Side& other,
+                    const std::vector<int>& offsets, const std::vector<UpArc>& arcs,
+                    const std::vector<int>& opp_offsets, const std::vector<UpArc>& opp_arcs) {
+        auto [d, u] = self.pop();
+        if (self.settled(u)) return;
+        self.settle(u);
+
+        if (other.reached(u) && d + other.distance(u) < best) {
+            best = d + other.distance(u);
+            meet = u;
+        }
+
+        // A higher node reaching u more cheaply means u is not on a shortest up-down path
+        for (int a = opp_offsets[u]; a < opp_offsets[u + 1]; a++) {
+            const UpArc& arc = opp_arcs[a];
+            if (self.distance(arc.head) + arc.weight < d) return;
+        }
+
+        for (int a = offsets[u]; a < offsets[u + 1]; a++) {
+            const UpArc& arc = arcs[a];
+            double nd = d + arc.weight;
+            if (nd < self.distance(arc.head)) {
+                self.label(arc.head, nd, u);
+                self.push(nd, arc.head);
+            }
+        }
+    };
+
+    bool turn = true;
+    while (true) {
+        bool fwd_open = !fwd.empty() && fwd.top().key < best;
+        bool bwd_open = !bwd.empty() && bwd.top().key < best;
+        if (!fwd_open && !bwd_open) break;
+
+        if (fwd_open && (turn || !bwd_open))
+            step(fwd, bwd, forwardOffsets, forwardArcs, backwardOffsets, backwardArcs);
+        else
+            step(bwd, fwd, backwardOffsets, backwardArcs, forwardOffsets, forwardArcs);
+        turn = !turn;
+    }
+
+    if (meet < 0)
+        return {};
+
+    // Up-down node sequence through the meeting node, then expand the shortcuts
+    std::vector<int> hops;
+    for (int v = meet; v != -1; v = fwd.parentOf(v))
+        hops.push_back(v);
+    std::reverse(hops.begin(), hops.end());
+    for (int v = bwd.parentOf(meet); v != -1; v = bwd.parentOf(v))
+        hops.push_back(v);
+
+    PathResult result;
+    result.found = true;
+    result.cost = best;
+    result.path.push_back(hops[0]);
+    for (size_t i = 1; i < hops.size(); i++)
+        unpack(hops[i - 1], hops[i], result.path);
+    return result;
+}
+
+inline const ContractionHierarchy::UpArc* ContractionHierarchy::findArc(int from, int to) const {
+    if (rank[from] < rank[to]) {
+        for (int a = forwardOffsets[from]; a < forwardOffsets[from + 1]; a++)
+            if (forwardArcs[a].head == to) return &forwardArcs[a];
+    } else {
+        for (int a = backwardOffsets[to]; a < backwardOffsets[to + 1]; a++)
+            if (backwardArcs[a].head == from) return &backwardArcs[a];
+    }
+    return nullptr;
+}
+
+// Appends the original nodes after `from` on the arc from -> to
+inline void ContractionHierarchy::unpack(int from, int to, std::vector<int>& path) const {
+    const UpArc* arc = findArc(from, to);
+    if (!arc || arc->mid < 0) {
+        path.push_back(to);
+        return;
+    }
+    int mid = arc->mid;
+    unpack(from, mid, path);
+    unpack(mid, to, path);
+}
+
+// Raw little-endian layout, the same one the in-memory vectors use
+inline void ContractionHierarchy::save(std::ostream& out) const {
+    auto put = [&](const void* data, size_t len) {
+        out.write(static_cast<const char*>(data), len);
+    };
+    auto put_vec = [&](const auto& v) {
+        uint64_t size = v.size();
+        put(&size, sizeof size);
+        put(v.data(), size * sizeof(v[0]));
+    };
+    put(&n, sizeof n);
+    put(&fingerprint, sizeof fingerprint);
+    put_vec(rank);
+    put_vec(forwardOffsets);
+    put_vec(forwardArcs);
+    put_vec(backwardOffsets);
+    put_vec(backwardArcs);
+}
+
+inline bool ContractionHierarchy::load(std::istream& in) {
+    auto get = [&](void* data, size_t len) {
+        return (bool)in.read(static_cast<char*>(data), len);
+    };
+    auto get_vec = [&](auto& v) {
+        uint64_t size = 0;
+        if (!get(&size, sizeof size) || size > (1ULL << 34)) return false;
+        v.resize(size);
+        return get(v.data(), size * sizeof(v[0]));
+    };
+    if (!get(&n, sizeof n) || !get(&fingerprint, sizeof fingerprint) ||
+        !get_vec(rank) || !get_vec(forwardOffsets) || !get_vec(forwardArcs) ||
+        !get_vec(backwardOffsets) || !get_vec(backwardArcs))
+        return false;
+    if (n < 0 || (int64_t)rank.size() != n || (int64_t)forwardOffsets.size() != (int64_t)n + 1 ||
+        (int64_t)backwardOffsets.size() != (int64_t)n + 1)
+        return false;
+
+    // The fingerprint only covers the graph, so the body is checked before any
+    // query indexes with it: ranks are a permutation, offsets are monotone and
+    // end at the arc count, arcs lead up, and a shortcut's middle node ranks
+    // below both ends, so unpack always terminates
+    std::vector<char> seen(n, 0);
+    for (int r : rank) {
+        if (r < 0 || r >= n || seen[r]) return false;
+        seen[r] = 1;
+    }
+    auto monotone = [&](const std::vector<int>& offs, size_t end) {
+        if (offs[0] != 0 || (size_t)offs[n] != end) return false;
+        for (int i = 0; i < n; i++)
+            if (offs[i] > offs[i + 1]) return false;
+        return true;
+    };
+    auto upward = [&](const std::vector<int>& offs, const std::vector<UpArc>& arcs) {
+        for (int u = 0; u < n; u++) {
+            for (int a = offs[u]; a < offs[u + 1]; a++) {
+                const UpArc& arc = arcs[a];
+                if (arc.head < 0 || arc.head >= n || rank[arc.head] <= rank[u] || !(arc.weight >= 0))
+                    return false;
+                if (arc.mid != -1 && (arc.mid < 0 || arc.mid >= n || rank[arc.mid] >= rank[u]))
+                    return false;
+            }
+        }
+        return true;
+    };
+    return monotone(forwardOffsets, forwardArcs.size()) && monotone(backwardOffsets, backwardArcs.size()) &&
+           upward(forwardOffsets, forwardArcs) && upward(backwardOffsets, backwardArcs);
+}
+
+constexpr char CH_FILE_MAGIC[4] = {'G', 'M', 'C', 'H'};
+constexpr uint32_t CH_FILE_VERSION = 1;
+
+// One file holds the distance and the time hierarchy
+inline bool save_hierarchies(const std::string& path,
+                             const ContractionHierarchy& distance,
+                             const ContractionHierarchy& time) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open())
+        return false;
+    out.write(CH_FILE_MAGIC, sizeof CH_FILE_MAGIC);
+    out.write(reinterpret_cast<const char*>(&CH_FILE_VERSION), sizeof CH_FILE_VERSION);
+    distance.save(out);
+    time.save(out);
+    return (bool)out;
+}
+
+// Fails if the file is missing, malformed, corrupt or was built from a different
+// graph; the caller then rebuilds
+inline bool load_hierarchies(const std::string& path, const Graph& graph,
+                             ContractionHierarchy& distance,
+                             ContractionHierarchy& time) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+    char magic[4];
+    uint32_t version = 0;
+    if (!in.read(magic, sizeof magic) || std::memcmp(magic, CH_FILE_MAGIC, sizeof magic) != 0)
+        return false;
+    if (!in.read(reinterpret_cast<char*>(&version), sizeof version) || version != CH_FILE_VERSION)
+        return false;
+    if (!distance.load(in) || !time.load(in))
+        return false;
+    if (distance.n != graph.numNodes() || distance.fingerprint != graph_fingerprint(graph, graph.arcLength) ||
+        time.n != graph.numNodes() || time.fingerprint != graph_fingerprint(graph, graph.arcTime))
+        return false;
+    distance.builtVersion = graph.version;
+    time.builtVersion = graph.version;
+    return true;
+}
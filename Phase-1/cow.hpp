@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+// Copy-on-write storage for graph versions. Copies share one payload, reads go
+// straight to it, and a write first gives the writer a private copy of whatever
+// it touches if anyone else still holds it. A version is a set of these, so a
+// new version only pays for the parts its update actually changed.
+//
+// Only the owner may write. A payload whose use_count is 1 is reachable from
+// nowhere else, so no reader can pick it up while it is being changed.
+
+// One shared payload, copied whole on the first write. For members that are
+// small or rarely written
+template <class C>
+class Cow {
+public:
+    Cow() : ptr(std::make_shared<C>()) {}
+    explicit Cow(C value) : ptr(std::make_shared<C>(std::move(value))) {}
+
+    const C& get() const { return *ptr; }
+    operator const C&() const { return *ptr; }
+
+    C& write() {
+        if (ptr.use_count() > 1)
+            ptr = std::make_shared<C>(*ptr);
+        return *ptr;
+    }
+
+    // Read-only view of the container, enough for range-for and lookups
+    auto size() const { return get().size(); }
+    bool empty() const { return get().empty(); }
+    auto begin() const { return get().begin(); }
+    auto end() const { return get().end(); }
+    auto data() const { return get().data(); }
+    decltype(auto) back() const { return get().back(); }
+    template <class K> decltype(auto) operator[](const K& k) const { return get()[k]; }
+    template <class K> decltype(auto) at(const K& k) const { return get().at(k); }
+    template <class K> auto find(const K& k) const { return get().find(k); }
+    template <class K> auto count(const K& k) const { return get().count(k); }
+
+private:
+    std::shared_ptr<C> ptr;
+};
+
+// Array cut into fixed blocks that are shared and copied one at a time, so
+// patching an item copies BLOCK items instead of the whole array. The block
+// table is one shared payload too, so copying the array is O(1); the first
+// write after a copy pays for the table, later ones only for their blocks
+template <class T, size_t BLOCK = 4096>
+class CowArray {
+public:
+    size_t size() const { return count; }
+
+    const T& operator[](size_t i) const { return (*blocks[i / BLOCK])[i % BLOCK]; }
+
+    T& write(size_t i) { return block(i / BLOCK)[i % BLOCK]; }
+
+    // Items [i, i + n) are contiguous if they came from one appendRun
+    const T* run(size_t i) const { return &(*this)[i]; }
+    T* writeRun(size_t i) { return &write(i); }
+
+    // Appends n items that do not cross a block boundary, skipping the rest of
+    // the last block if needed; returns the index of the first. A run longer
+    // than a block cannot be contiguous, so it is refused outright
+    size_t appendRun(size_t n) {
+        if (n > BLOCK) throw std::length_error("CowArray::appendRun: run longer than a block");
+        if (count % BLOCK + n > BLOCK) count += BLOCK - count % BLOCK;
+        size_t begin = count;
+        resize(count + n);
+        return begin;
+    }
+
+    void assign(size_t n, const T& value) {
+        clear();
+        resize(n, value);
+    }
+
+    // Grows to n items, new ones set to value. Shrinking drops the blocks past
+    // the new end, so a later grow never brings back their old items
+    void resize(size_t n, const T& value = T()) {
+        if (n <= count) {
+            size_t keep = (n + BLOCK - 1) / BLOCK;
+            if (keep < blocks.size()) blocks.write().resize(keep);
+            count = n;
+            return;
+        }
+        if (count % BLOCK) {
+            std::vector<T>& last = block(count / BLOCK);
+            size_t from = count % BLOCK, to = std::min(BLOCK, from + (n - count));
+            std::fill(last.begin() + from, last.begin() + to, value);
+        }
+        while (blocks.size() * BLOCK < n)
+            blocks.write().push_back(std::make_shared<std::vector<T>>(BLOCK, value));
+        count = n;
+    }
+
+    // Drops this array's table, versions sharing it keep theirs
+    void clear() {
+        blocks = Cow<std::vector<std::shared_ptr<std::vector<T>>>>();
+        count = 0;
+    }
+
+private:
+    Cow<std::vector<std::shared_ptr<std::vector<T>>>> blocks;
+    size_t count = 0;
+
+    std::vector<T>& block(size_t b) {
+        std::vector<std::shared_ptr<std::vector<T>>>& table = blocks.write();
+        if (table[b].use_count() > 1)
+            table[b] = std::make_shared<std::vector<T>>(*table[b]);
+        return *table[b];
+    }
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+#include "workspace.hpp"
+
+// Customizable route planning overlay. The partition into nested cells only
+// looks at coordinates, so it never changes; each cell stores a matrix of
+// shortest in-cell distances between its boundary nodes for both metrics.
+// An edge update only re-customizes the cells that contain both endpoints.
+class CRPOverlay {
+public:
+    struct Cell {
+        int boundaryBegin;// into boundary[level]
+        int boundaryCount;
+        int matrixBegin;// into matrix[metric][level], boundaryCount^2 entries
+    };
+
+    int n = 0;
+    int levels = 0;
+    uint64_t layout = 0;// Graph::layout the boundary sets were computed for
+
+    std::vector<std::vector<int>> cell;// cell[l][v], level 0 is the finest
+    std::vector<std::vector<Cell>> cells;// cells[l][c]
+    std::vector<std::vector<int>> boundary;// boundary nodes of every cell, cell by cell
+    std::vector<std::vector<int>> slot;// slot[l][v]: position of v in its cell's boundary, -1 if interior
+    std::vector<std::vector<double>> matrix[2];// matrix[metric][l], metric 0 distance, 1 time
+
+    // Cells at level l hold at most base_cell * fanout^l nodes
+    CRPOverlay(Graph& graph, int base_cell = 64, int fanout = 8) : graph(graph) {
+        partition(base_cell, fanout);
+        rebuild();
+        graph.edgeListeners.push_back([this](int id) { edgeChanged(id); });
+    }
+
+    CRPOverlay(const CRPOverlay&) = delete;
+    CRPOverlay& operator=(const CRPOverlay&) = delete;
+
+    bool current() const {
+        return layout == graph.layout && n == graph.numNodes();
+    }
+
+    PathResult query(SearchWorkspace& ws, int source, int target, const std::string& mode) const;
+
+private:
+    Graph& graph;
+    SearchWorkspace scratch;// customization runs single-threaded inside the update
+
+    static int metric_of(const std::string& mode) { return mode == "distance" ? 0 : 1; }
+
+    const ArcWeights& weights(int metric) const {
+        return metric == 0 ? graph.arcLength : graph.arcTime;
+    }
+
+    void partition(int base_cell, int fanout);
+    void rebuild();
+    void customize(int level, int c);
+    void edgeChanged(int id);
+
+    // Highest level whose cell around v holds neither endpoint of the query, -1 if none
+    int queryLevel(int v, int s, int t) const {
+        for (int l = levels - 1; l >= 0; l--) {
+            int c = cell[l][v];
+            if (c != cell[l][s] && c != cell[l][t])
+                return l;
+        }
+        return -1;
+    }
+
+    // Arcs of v inside cell c of `level`, on the overlay of the level below
+    template <typename F>
+    void forEachCellArc(int level, int c, int v, int metric, F&& relax) const {
+        const ArcWeights& w = weights(metric);
+        if (level == 0) {
+            for (int a = graph.offsets[v]; a < graph.offsets[v + 1]; a++) {
+                if (cell[0][graph.arcTarget[a]] == c)
+                    relax(graph.arcTarget[a], w[a]);
+            }
+            return;
+        }
+        int sub = cell[level - 1][v];
+        forEachShortcut(level - 1, v, metric, relax);
+        for (int a = graph.offsets[v]; a < graph.offsets[v + 1]; a++) {
+            int h = graph.arcTarget[a];
+            if (cell[level - 1][h] != sub && cell[level][h] == c)
+                relax(h, w[a]);
+        }
+    }
+
+    // Matrix row of boundary node v in its cell at `level`
+    template <typename F>
+    void forEachShortcut(int level, int v, int metric, F&& relax) const {
+        const Cell& cl = cells[level][cell[level][v]];
+        int row = slot[level][v];
+        const double* m = matrix[metric][level].data() + cl.matrixBegin + row * cl.boundaryCount;
+        for (int j = 0; j < cl.boundaryCount; j++) {
+            int h = boundary[level][cl.boundaryBegin + j];
+            if (h != v && m[j] < std::numeric_limits<double>::infinity())
+                relax(h, m[j]);
+        }
+    }
+
+    void unpackShortcut(SearchWorkspace::Side& local, int level, int from, int to, const std::string& mode,
+                        std::vector<int>& path) const;
+};
+
+// Recursive coordinate bisection; a level-l cell is the largest subtree that fits its size
+inline void CRPOverlay::partition(int base_cell, int fanout) {
+    n = graph.numNodes();
+    std::vector<int> limits;
+    for (long long size = base_cell; size < n; size *= fanout)
+        limits.push_back((int)size);
+    levels = (int)limits.size();
+    cell.assign(levels, std::vector<int>(n, -1));
+    cells.assign(levels, {});
+
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+
+    struct Range { int lo, hi, assigned; };// assigned: lowest level already given a cell
+    std::vector<Range> stack = {{0, n, levels}};
+    while (!stack.empty()) {
+        Range r = stack.back();
+        stack.pop_back();
+        int assigned = r.assigned;
+        for (int l = assigned - 1; l >= 0 && r.hi - r.lo <= limits[l]; l--) {
+            int id = (int)cells[l].size();
+            cells[l].push_back({0, 0, 0});
+            for (int i = r.lo; i < r.hi; i++)
+                cell[l][perm[i]] = id;
+            assigned = l;
+        }
+        if (assigned == 0) continue;
+
+        // Split across the wider coordinate extent at the median
+        double min_lat = 1e18, max_lat = -1e18, min_lon = 1e18, max_lon = -1e18;
+        for (int i = r.lo; i < r.hi; i++) {
+            const Node& nd = graph.nodes[perm[i]];
+            min_lat = std::min(min_lat, nd.lat); max_lat = std::max(max_lat, nd.lat);
+            min_lon = std::min(min_lon, nd.lon); max_lon = std::max(max_lon, nd.lon);
+        }
+        bool by_lat = (max_lat - min_lat) >= (max_lon - min_lon);
+        int mid = r.lo + (r.hi - r.lo) / 2;
+        std::nth_element(perm.begin() + r.lo, perm.begin() + mid, perm.begin() + r.hi, [&](int a, int b) {
+            return by_lat ? graph.nodes[a].lat < graph.nodes[b].lat : graph.nodes[a].lon < graph.nodes[b].lon;
+        });
+        stack.push_back({r.lo, mid, assigned});
+        stack.push_back({mid, r.hi, assigned});
+    }
+}
+
+// Boundary sets depend on which arcs exist, so they are redone when the CSR is rebuilt
+inline void CRPOverlay::rebuild() {
+    layout = graph.layout;
+    boundary.assign(levels, {});
+    slot.assign(levels, std::vector<int>(n, -1));
+    matrix[0].assign(levels, {});
+    matrix[1].assign(levels, {});
+
+    for (int l = 0; l < levels; l++) {
+        std::vector<char> is_boundary(n, 0);
+        for (int u = 0; u < n; u++) {
+            for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                int v = graph.arcTarget[a];
+                if (cell[l][u] != cell[l][v])
+                    is_boundary[u] = is_boundary[v] = 1;
+            }
+        }
+        std::vector<std::vector<int>> members(cells[l].size());
+        for (int v = 0; v < n; v++)
+            if (is_boundary[v]) members[cell[l][v]].push_back(v);
+
+        int matrix_size = 0;
+        for (size_t c = 0; c < cells[l].size(); c++) {
+            Cell& cl = cells[l][c];
+            cl.boundaryBegin = (int)boundary[l].size();
+            cl.boundaryCount = (int)members[c].size();
+            cl.matrixBegin = matrix_size;
+            matrix_size += cl.boundaryCount * cl.boundaryCount;
+            for (int j = 0; j < cl.boundaryCount; j++) {
+                slot[l][members[c][j]] = j;
+                boundary[l].push_back(members[c][j]);
+            }
+        }
+        matrix[0][l].assign(matrix_size, std::numeric_limits<double>::infinity());
+        matrix[1][l].assign(matrix_size, std::numeric_limits<double>::infinity());
+    }
+
+    for (int l = 0; l < levels; l++)
+        for (int c = 0; c < (int)cells[l].size(); c++)
+            customize(l, c);
+}
+
+// One Dijkstra per boundary node, confined to the cell, for both metrics
+inline void CRPOverlay::customize(int level, int c) {
+    const Cell& cl = cells[level][c];
+    SearchWorkspace::Side& search = scratch.forward;
+    for (int metric = 0; metric < 2; metric++) {
+        double* m = matrix[metric][level].data() + cl.matrixBegin;
+        for (int i = 0; i < cl.boundaryCount; i++) {
+            int src = boundary[level][cl.boundaryBegin + i];
+            search.reset(n);
+            search.label(src, 0.0, -1);
+            search.push(0.0, src);
+            while (!search.empty()) {
+                auto [d, u] = search.pop();
+                if (search.settled(u)) continue;
+                search.settle(u);
+                forEachCellArc(level, c, u, metric, [&](int v, double w) {
+                    if (d + w < search.distance(v)) {
+                        search.label(v, d + w, u);
+                        search.push(d + w, v);
+                    }
+                });
+            }
+            for (int j = 0; j < cl.boundaryCount; j++)
+                m[i * cl.boundaryCount + j] = search.distance(boundary[level][cl.boundaryBegin + j]);
+        }
+    }
+}
+
+// Only cells holding both endpoints see the edge, and they nest bottom-up
+inline void CRPOverlay::edgeChanged(int id) {
+    if (!current()) {
+        if (n != graph.numNodes())
+            return;
+        rebuild();
+        return;
+    }
+    const Edge* e = graph.edge(id);
+    if (!e) return;
+    int u = graph.index(e->u), v = graph.index(e->v);
+    if (u < 0 || v < 0) return;
+    for (int l = 0; l < levels; l++) {
+        if (cell[l][u] == cell[l][v])
+            customize(l, cell[l][u]);
+    }
+}
+
+// Dijkstra that scans original arcs near the endpoints and cell matrices elsewhere
+inline PathResult CRPOverlay::query(SearchWorkspace& ws, int source, int target, const std::string& mode) const {
+    if (source < 0 || source >= n || target < 0 || target >= n)
+        return {};
+    const int metric = metric_of(mode);
+    const ArcWeights& w = weights(metric);
+
+    SearchWorkspace::Side& search = ws.forward;
+    search.reset(n);
+    search.label(source, 0.0, -1);
+    search.push(0.0, source);
+
+    while (!search.empty()) {
+        auto [d, u] = search.pop();
+        if (search.settled(u)) continue;
+        search.settle(u);
+        if (u == target) break;
+
+        auto relax = [&](int v, double weight) {
+            if (d + weight < search.distance(v)) {
+                search.label(v, d + weight, u);
+                search.push(d + weight, v);
+            }
+        };
+
+        int l = queryLevel(u, source, target);
+        if (l < 0) {
+            for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++)
+                relax(graph.arcTarget[a], w[a]);
+            continue;
+        }
+        forEachShortcut(l, u, metric, relax);
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            if (cell[l][graph.arcTarget[a]] != cell[l][u])
+                relax(graph.arcTarget[a], w[a]);
+        }
+    }
+
+    if (!search.settled(target))
+        return {};
+
+    std::vector<int> hops;
+    for (int v = target; v != -1; v = search.parentOf(v))
+        hops.push_back(v);
+    std::reverse(hops.begin(), hops.end());
+
+    PathResult result;
+    result.found = true;
+    result.cost = search.distance(target);
+    result.path.push_back(source);
+    for (size_t i = 1; i < hops.size(); i++) {
+        int from = hops[i - 1], to = hops[i];
+        // Nodes scanned at an overlay level only relax original arcs that leave their cell
+        int l = queryLevel(from, source, target);
+        if (l >= 0 && cell[l][from] == cell[l][to])
+            unpackShortcut(ws.backward, l, from, to, mode, result.path);
+        else
+            result.path.push_back(to);
+    }
+    return result;
+}
+
+// Recovers the original nodes of a matrix entry with a Dijkstra confined to the cell
+inline void CRPOverlay::unpackShortcut(SearchWorkspace::Side& local, int level, int from, int to,
+                                       const std::string& mode, std::vector<int>& path) const {
+    const ArcWeights& w = weights(metric_of(mode));
+    const int c = cell[level][from];
+    local.reset(n);
+    local.label(from, 0.0, -1);
+    local.push(0.0, from);
+    while (!local.empty()) {
+        auto [d, u] = local.pop();
+        if (local.settled(u)) continue;
+        local.settle(u);
+        if (u == to) break;
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            if (cell[level][v] != c) continue;
+            if (d + w[a] < local.distance(v)) {
+                local.label(v, d + w[a], u);
+                local.push(d + w[a], v);
+            }
+        }
+    }
+    size_t mark = path.size();
+    for (int v = to; v != from && v != -1; v = local.parentOf(v))
+        path.push_back(v);
+    std::reverse(path.begin() + mark, path.end());
+}
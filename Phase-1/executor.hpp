@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include "json.hpp"
+#include "Graph.hpp"
+#include "handle.hpp"
+#include "output.hpp"
+#include "pool.hpp"
+#include "workspace.hpp"
+
+using json = nlohmann::json;
+
+// Answers the event stream with read queries spread over a work-stealing pool,
+// each worker with its own search workspace. Edge updates are applied in order
+// on the calling thread. Results go out in input order.
+//
+// A read pins the graph version that was current when it arrived: an immutable
+// snapshot sharing all unchanged members with the live graph. Updates then go
+// ahead without waiting for earlier reads, which keep seeing their own version
+// until they finish and drop the pin. Only the CRP overlay is patched in place
+// on updates, so with it (or with one thread, where nothing would overlap)
+// each update still waits for the reads before it.
+class QueryExecutor {
+public:
+    // Pinned versions still waiting for their reads; each may hold private
+    // copies of the members its update wrote, so this bounds the extra memory
+    static constexpr int MAX_PINNED_VERSIONS = 8;
+
+    // batch caps how many reads wait before they are answered anyway, 0 for no
+    // cap; stream syncs the output after every batch
+    QueryExecutor(Graph& graph, const Accelerators& accel, ResultWriter& out,
+                  int threads, size_t batch, bool stream)
+        : graph(graph), accel(accel), out(out), pool(threads), batch(batch), stream(stream),
+          workspaces(pool.size()), updates(out.isPretty()) {
+        for (int w = 0; w < pool.size(); w++)
+            parts.push_back(std::make_unique<ResultWriter>(out.isPretty()));
+    }
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    void submit(json event) {
+        if (is_update(event)) {
+            // A single worker gains nothing from running reads after the update
+            if (pool.size() == 1 || accel.crp || pinnedVersions >= MAX_PINNED_VERSIONS)
+                finish();
+            size_t begin = updates.size();
+            timed(updates, [&]() { apply_update(event, graph, updates); });
+            spans.push_back({&updates, begin, updates.size()});
+            // Later reads need a new version; earlier ones keep theirs
+            current.reset();
+            if (reads.empty()) finish();
+            return;
+        }
+        if (!current) {
+            current = graph.snapshot();
+            pinnedVersions++;
+        }
+        reads.push_back({std::move(event), current, spans.size()});
+        spans.push_back({});
+        if (batch && reads.size() >= batch)
+            finish();
+    }
+
+    // Answers every read still waiting and writes out everything submitted so far
+    void finish() {
+        pool.run((int)reads.size(), [this](int w, int i) {
+            const Read& read = reads[i];
+            ResultWriter& part = *parts[w];
+            size_t begin = part.size();
+            timed(part, [&]() { answer_query(read.event, *read.graph, workspaces[w], accel, part); });
+            spans[read.slot] = {&part, begin, part.size()};
+        });
+        // Workers finish in any order; copy each result back in input order
+        for (const Span& span : spans)
+            out.append(*span.part, span.begin, span.end);
+        for (auto& part : parts)
+            part->clear();
+        updates.clear();
+        spans.clear();
+        // Dropping the pins frees versions no longer current, and an unshared
+        // current version lets the next update write in place
+        reads.clear();
+        current.reset();
+        pinnedVersions = 0;
+        if (stream) out.sync();
+    }
+
+private:
+    struct Read {
+        json event;
+        std::shared_ptr<const Graph> graph;// version the read is answered on
+        size_t slot;// position in spans
+    };
+
+    // Where a result ended up: bytes [begin, end) of one of the writers
+    struct Span {
+        const ResultWriter* part;
+        size_t begin, end;
+    };
+
+    Graph& graph;
+    const Accelerators& accel;
+    ResultWriter& out;
+    ThreadPool pool;
+    size_t batch;
+    bool stream;
+    std::vector<SearchWorkspace> workspaces;// one per worker
+    std::vector<std::unique_ptr<ResultWriter>> parts;// each worker's results for the current batch
+    ResultWriter updates;// results of the updates in the current batch
+    std::vector<Read> reads;
+    std::vector<Span> spans;// one per event since the last finish, in input order
+    std::shared_ptr<const Graph> current;// version new reads pin, made on demand
+    int pinnedVersions = 0;
+
+    template <class Body>
+    static void timed(ResultWriter& writer, Body body) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        writer.beginObject();
+        body();
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        writer.field("processing_time",
+            std::chrono::duration<double, std::milli>(end_time - start_time).count());
+        writer.endObject();
+    }
+};
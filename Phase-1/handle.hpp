@@ -1,54 +1,155 @@
 #pragma once
 
 #include<iostream>
+#include<memory>
 #include "json.hpp"
 #include "Graph.hpp"
 #include "pathfinding.hpp"
+#include "workspace.hpp"
+#include "ch.hpp"
+#include "crp.hpp"
+#include "timedep.hpp"
+#include "profile.hpp"
+#include "spatial.hpp"
+#include "buckets.hpp"
+#include "output.hpp"
 
 using json = nlohmann::json;
 
-json process_query(const json& query, Graph& graph) {
-    std::string type = query["type"];
+// Optional preprocessed speedup structures, shared by every query thread
+struct Accelerators {
+    std::unique_ptr<ContractionHierarchy> chDistance;
+    std::unique_ptr<ContractionHierarchy> chTime;
+    std::unique_ptr<CRPOverlay> crp;// stays valid across edge updates
+    std::unique_ptr<Landmarks> landmarks;// A* bounds for both metrics
+    std::unique_ptr<PoiSpatialIndex> poiIndex;// Euclidean kNN, built once nodes are loaded
+    std::unique_ptr<SnapIndex> snapIndex;// coordinates -> nearest routable node
+    std::unique_ptr<PoiBuckets> poiBuckets;// road-distance kNN for sparse tags, until the first update
+    bool bidirectional = false;// default graph search when a query names no algorithm
+
+    // Hierarchy for a mode, nullptr if none was built or the graph changed since
+    const ContractionHierarchy* hierarchy(const Graph& graph, const std::string& mode) const {
+        const ContractionHierarchy* ch = (mode == "distance") ? chDistance.get() : chTime.get();
+        return (ch && ch->current(graph)) ? ch : nullptr;
+    }
+
+    // Dense index of the routable node nearest to a {"lat", "lon"} point, -1 if none
+    int snap(const Graph& graph, const json& point) const {
+        double lat = point["lat"], lon = point["lon"];
+        if (snapIndex && snapIndex->current(graph))
+            return snapIndex->snap(graph, lat, lon);
+        return snap_to_node(graph, lat, lon);
+    }
+};
+
+// Searches work on dense indices, results go back out as node ids
+inline std::vector<int> to_node_ids(const Graph& graph, const std::vector<int>& dense) {
+    std::vector<int> ids;
+    ids.reserve(dense.size());
+    for (int i : dense)
+        ids.push_back(graph.nodes[i].id);
+    return ids;
+}
 
-    if (type == "remove_edge") {
-        int edge_id = query["edge_id"];
-        graph.removeEdge(graph.edges[edge_id]);
-        return {{"done", true}};
+// Reads a query's optional constraints: forbidden node ids as dense indices,
+// forbidden road type names as a mask. Unknown nodes and names are skipped
+inline void parse_constraints(const json& query, const Graph& graph,
+                              std::vector<int>& forbidden_nodes, RoadTypeMask& forbidden_road_types) {
+    if (!query.contains("constraints"))
+        return;
+    const json& cons = query["constraints"];
+    if (cons.contains("forbidden_nodes")) {
+        for (auto& n : cons["forbidden_nodes"]) {
+            int idx = graph.index(n.get<int>());
+            if (idx >= 0)
+                forbidden_nodes.push_back(idx);
+        }
+    }
+    if (cons.contains("forbidden_road_types")) {
+        // Names no edge has cannot forbid anything
+        for (auto& r : cons["forbidden_road_types"]) {
+            int type = graph.roadTypeId(r.get<std::string>());
+            if (type >= 0)
+                forbidden_road_types.set(type);
+        }
     }
-    else if (type == "modify_edge") {
-        int edge_id = query["edge_id"];
+}
+
+inline bool is_update(const json& query) {
+    const std::string& type = query["type"].get_ref<const std::string&>();
+    return type == "remove_edge" || type == "modify_edge";
+}
+
+// Applies a remove_edge or modify_edge event to graph. The answer's fields go
+// into the object the caller opened on out, keys in dump() order
+void apply_update(const json& query, Graph& graph, ResultWriter& out) {
+    int edge_id = query["edge_id"];
+    if (query["type"] == "remove_edge")
+        graph.removeEdge(edge_id);
+    else
         graph.modifyEdge(edge_id, query["patch"]);
-        return {{"done", true}};
+    out.field("done", true);
+}
+
+// Answers a read-only query against one version of the graph. ws is the
+// calling thread's scratch space, reused across queries
+void answer_query(const json& query, const Graph& graph, SearchWorkspace& ws, const Accelerators& accel, ResultWriter& out) {
+    std::string type = query["type"];
+
+    if (type == "shortest_path") {
+        // Endpoints are node ids, or coordinates snapped to the nearest routable node
+        int source = query.contains("source_point") ? accel.snap(graph , query["source_point"])
+                                                    : graph.index(query["source"].get<int>());
+        int target = query.contains("target_point") ? accel.snap(graph , query["target_point"])
+                                                    : graph.index(query["target"].get<int>());
+        std::string mode = query["mode"];
+
+        std::vector<int> forbidden_nodes;
+        RoadTypeMask forbidden_road_types;
+        parse_constraints(query, graph, forbidden_nodes, forbidden_road_types);
+        // A departure time makes time mode follow the speed profiles. Otherwise
+        // unconstrained queries go to the hierarchy while it matches the graph,
+        // then to the overlay, which is re-customized on every update
+        PathResult result;
+        bool unconstrained = forbidden_nodes.empty() && forbidden_road_types.none();
+        const ContractionHierarchy* ch = accel.hierarchy(graph , mode);
+        if (mode == "time" && query.contains("departure_time"))
+            result = time_dependent_shortest_path(graph , ws , source , target , query["departure_time"].get<double>() , forbidden_nodes , forbidden_road_types);
+        else if (ch && unconstrained)
+            result = ch->query(ws , source , target);
+        else if (accel.crp && accel.crp->current() && unconstrained)
+            result = accel.crp->query(ws , source , target , mode);
+        else if (query.value("algorithm", accel.bidirectional ? "bidirectional" : "astar") == "bidirectional")
+            result = bidirectional_shortest_path(graph , ws , source , target , mode , forbidden_nodes , forbidden_road_types , accel.landmarks.get());
+        else
+            result = shortest_path(graph , ws , source , target , mode , forbidden_nodes , forbidden_road_types , accel.landmarks.get());
+
+        out.field("id", query["id"]);
+        if(result.found){
+            out.field(mode == "distance" ? "minimum_distance" : "minimum_time", result.cost);
+            out.field("path", to_node_ids(graph , result.path));
+        }
+        out.field("possible", result.found);
+        return;
     }
-    else if (type == "shortest_path") {
+    else if (type == "shortest_path_profile") {
         int source = query["source"];
         int target = query["target"];
-        std::string mode = query["mode"];
 
-        std::unordered_set<int> forbidden_nodes;
-        std::unordered_set<std::string>forbidden_road_types;
+        std::vector<int> forbidden_nodes;
+        RoadTypeMask forbidden_road_types;
+        parse_constraints(query, graph, forbidden_nodes, forbidden_road_types);
+        ProfileResult result = profile_search(graph , ws , graph.index(source) , graph.index(target) , forbidden_nodes , forbidden_road_types);
 
-        if (query.contains("constraints")) {
-            auto cons = query["constraints"];
-            if (cons.contains("forbidden_nodes")) {
-                for (auto& n : cons["forbidden_nodes"])
-                    forbidden_nodes.insert(n.get<int>());
-            }
-            if (cons.contains("forbidden_road_types")) {
-                for (auto& r : cons["forbidden_road_types"])
-                    forbidden_road_types.insert(r.get<std::string>());
-            }
-        }
-        auto [found , result] = shortest_path(graph , source , target , mode , forbidden_nodes , forbidden_road_types);
+        out.field("id", query["id"]);
+        out.field("possible", result.found);
 
-        json out;
-        out["id"] = query["id"];
-        out["possible"] = found;
-
-        if(found)
-            out.update(result);
-            
-        return out;
+        // One travel time per departure slot, slot i leaving at i * slot_seconds
+        if(result.found){
+            out.field("slot_seconds", PROFILE_SLOT_SECONDS);
+            out.field("travel_times", result.travel);
+        }
+        return;
     }
     else if (type == "knn") {
         std::string pois = query["pois"];
@@ -57,24 +158,69 @@ json process_query(const json& query, Graph& graph) {
         double lat = query["query_point"]["lat"];
         double lon = query["query_point"]["lon"];
 
-        json out;
-        out["id"] = id;
+        // No node carries a tag the graph has never seen
+        int tag = graph.poiTagId(pois);
 
+        // id is the query's own; the search starts from the node nearest the query point.
+        // Buckets answer sparse tags while the hierarchy matches the graph, Dijkstra the rest
         if(query["metric"] == "shortest_path"){
-            out["nodes"] = knn_shortest_path(graph , id , pois , k);
-            return out;
+            out.field("id", id);
+            int source = tag < 0 ? -1 : accel.snap(graph , query["query_point"]);
+            if (tag < 0)
+                out.field("nodes", std::vector<int>());
+            else if (accel.poiBuckets && accel.poiBuckets->current(graph) && accel.poiBuckets->covers(tag))
+                out.field("nodes", to_node_ids(graph , accel.poiBuckets->nearest(ws , source , tag , k)));
+            else
+                out.field("nodes", to_node_ids(graph , knn_shortest_path(graph , ws , source , tag , k)));
+            return;
         }
         else if(query["metric"] == "Euclidean"){
-            out["nodes"] = knn_euclidean(graph , id , lat , lon , pois , k);
-            return out;
+            out.field("id", id);
+            if (tag < 0)
+                out.field("nodes", std::vector<int>());
+            else if (accel.poiIndex && accel.poiIndex->current(graph))
+                out.field("nodes", to_node_ids(graph , accel.poiIndex->nearest(lat , lon , tag , k)));
+            else
+                out.field("nodes", to_node_ids(graph , knn_euclidean(graph , lat , lon , tag , k)));
+            return;
+        }
+        else if(query["metric"] == "Geodesic"){
+            // Great-circle meters, so longitude counts less away from the equator
+            std::vector<std::pair<double, int>> nearest;
+            if (tag >= 0) {
+                if (accel.poiIndex && accel.poiIndex->current(graph))
+                    nearest = accel.poiIndex->nearestGeodesic(lat , lon , tag , k);
+                else
+                    nearest = knn_geodesic(graph , lat , lon , tag , k);
+            }
+            std::vector<int> nodes;
+            std::vector<double> distances;
+            for (auto& [d, v] : nearest) {
+                nodes.push_back(graph.nodes[v].id);
+                distances.push_back(d);
+            }
+            if (query.value("with_distances", false))
+                out.field("distances", distances);
+            out.field("id", id);
+            out.field("nodes", nodes);
+            return;
         }
         else{
-            return {{"id", id} , {"error", "Invalid metric"}};
+            out.field("error", "Invalid metric");
+            out.field("id", id);
+            return;
         }
         
     }
 
-    return {{"error", "unknown query type"}};
+    out.field("error", "unknown query type");
+}
+
+void process_query(const json& query, Graph& graph, SearchWorkspace& ws, const Accelerators& accel, ResultWriter& out) {
+    if (is_update(query))
+        apply_update(query, graph, out);
+    else
+        answer_query(query, graph, ws, accel, out);
 }
 
 
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "Graph.hpp"
+
+using json = nlohmann::json;
+
+// Streaming graph.json loader on top of json::sax_parse, and the only place
+// graph.json is validated. Each node and edge is checked as soon as its object
+// closes, then moved straight into the graph; no document tree is ever built.
+class GraphSaxLoader {
+public:
+    explicit GraphSaxLoader(Graph& graph) : graph(graph) {}
+
+    // True once the top-level object closed and the graph was built
+    bool complete() const { return done; }
+
+    bool null() { return scalar({}); }
+    bool boolean(bool b) {
+        Value v;
+        v.kind = Value::Bool;
+        v.b = b;
+        return scalar(v);
+    }
+    bool number_integer(json::number_integer_t i) {
+        Value v;
+        v.kind = Value::Int;
+        v.i = i;
+        v.d = (double)i;
+        return scalar(v);
+    }
+    bool number_unsigned(json::number_unsigned_t u) { return number_integer((json::number_integer_t)u); }
+    bool number_float(json::number_float_t d, const std::string&) {
+        Value v;
+        v.kind = Value::Float;
+        v.d = d;
+        return scalar(v);
+    }
+    bool string(std::string& s) {
+        Value v;
+        v.kind = Value::String;
+        v.s = std::move(s);
+        return scalar(v);
+    }
+    bool binary(json::binary_t&) { return scalar({}); }
+
+    bool key(std::string& k) {
+        if (state() == Meta || state() == NodeObject || state() == EdgeObject)
+            field = slot(k);
+        currentKey = std::move(k);
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        switch (state()) {
+        case Start: stack.push_back(Root); return true;
+        case Root:
+            if (currentKey == "meta") {
+                metaRecord = {};
+                stack.push_back(Meta);
+                return true;
+            }
+            return container(false);
+        case Nodes:
+            record = {};
+            stack.push_back(NodeObject);
+            return true;
+        case Edges:
+            record = {};
+            profile.clear();
+            stack.push_back(EdgeObject);
+            return true;
+        default: return container(false);
+        }
+    }
+
+    bool start_array(std::size_t) {
+        switch (state()) {
+        case Root:
+            if (currentKey == "nodes") {
+                sawNodes = true;
+                stack.push_back(Nodes);
+                return true;
+            }
+            if (currentKey == "edges") {
+                sawEdges = true;
+                stack.push_back(Edges);
+                return true;
+            }
+            return container(true);
+        case NodeObject:
+            if (field == POIS) {
+                record[POIS].kind = Value::Array;
+                pois.clear();
+                stack.push_back(Pois);
+                return true;
+            }
+            return container(true);
+        case EdgeObject:
+            if (field == PROFILE) {
+                record[PROFILE].kind = Value::Array;
+                stack.push_back(Profile);
+                return true;
+            }
+            return container(true);
+        default: return container(true);
+        }
+    }
+
+    bool end_object() {
+        State closing = state();
+        stack.pop_back();
+        switch (closing) {
+        case Meta: return checkMeta();
+        case NodeObject: return emitNode();
+        case EdgeObject: return emitEdge();
+        case Root: return finish();
+        default: return true;
+        }
+    }
+
+    bool end_array() {
+        stack.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+        std::cerr << "Invalid graph.json: " << ex.what() << "\n";
+        return false;
+    }
+
+private:
+    enum State { Start, Root, Meta, Nodes, NodeObject, Pois, Edges, EdgeObject, Profile, Skip };
+
+    // Field of a node, edge or meta object as parsed. Containers only record
+    // that they were there; pois and speed_profile are collected separately
+    struct Value {
+        enum Kind { Null, Bool, Int, Float, String, Array, Object } kind = Null;
+        bool present = false;
+        bool b = false;
+        int64_t i = 0;
+        double d = 0.0;
+        std::string s;
+
+        bool integer() const { return kind == Int; }
+        bool number() const { return kind == Int || kind == Float; }
+    };
+
+    // Known keys share slots across record types; anything else counts as extra
+    enum Slot { ID, LAT, LON, POIS, U = 1, V = 2, LENGTH = 3, TIME = 4, ONEWAY = 5, ROAD_TYPE = 6, PROFILE = 7,
+                NODES = 1, DESCRIPTION = 2, SLOTS = 8, EXTRA = -1 };
+
+    struct Record {
+        Value f[SLOTS];
+        int extra = 0;
+        Value& operator[](int s) { return f[s]; }
+    };
+
+    Graph& graph;
+    std::vector<State> stack{Start};
+    std::string currentKey;
+    int field = EXTRA;
+    Record record, metaRecord;
+    std::vector<std::string> pois;
+    std::vector<double> profile;
+    ProfileIndex profiles;// dedups speed profiles across edges
+    bool sawMeta = false, sawNodes = false, sawEdges = false;
+    bool done = false;
+
+    State state() const { return stack.back(); }
+
+    int slot(const std::string& k) {
+        State s = state();
+        int found = EXTRA;
+        if (k == "id") found = ID;
+        else if (s == NodeObject) {
+            if (k == "lat") found = LAT;
+            else if (k == "lon") found = LON;
+            else if (k == "pois") found = POIS;
+        }
+        else if (s == EdgeObject) {
+            if (k == "u") found = U;
+            else if (k == "v") found = V;
+            else if (k == "length") found = LENGTH;
+            else if (k == "average_time") found = TIME;
+            else if (k == "oneway") found = ONEWAY;
+            else if (k == "road_type") found = ROAD_TYPE;
+            else if (k == "speed_profile") found = PROFILE;
+        }
+        else if (s == Meta) {
+            if (k == "nodes") found = NODES;
+            else if (k == "description") found = DESCRIPTION;
+        }
+
+        Record& r = (s == Meta) ? metaRecord : record;
+        if (found == EXTRA) r.extra++;
+        else r[found].present = true;
+        return found;
+    }
+
+    bool fail(const char* message) {
+        std::cerr << message;
+        return false;
+    }
+
+    // A container where the format expects something else: record it, then skip its contents
+    bool container(bool array) {
+        State s = state();
+        if (s == Nodes) return fail("Fields missing or extra in nodes in graph.json\n");
+        if (s == Edges) return fail("Fields missing or extra in edge in graph.json\n");
+        if (s == Pois) return fail("Fields in node > pois must be a string\n");
+        if (s == Profile) return fail("Edge speed profiles values must be number\n");
+        if (s == Root && currentKey == "meta") return fail("Fields missing or extra in meta in graph.json\n");
+        if (s == Root && (currentKey == "nodes" || currentKey == "edges"))
+            return fail(currentKey == "nodes" ? "Nodes is an array\n" : "Edges should be a array\n");
+        if (s == Root) std::cerr << "Graph.json should have 3 correct parameters\n";
+        if ((s == Meta || s == NodeObject || s == EdgeObject) && field != EXTRA) {
+            Record& r = (s == Meta) ? metaRecord : record;
+            r[field].kind = array ? Value::Array : Value::Object;
+        }
+        stack.push_back(Skip);
+        return true;
+    }
+
+    bool scalar(Value v) {
+        switch (state()) {
+        case Root:
+            if (currentKey == "meta") return fail("Fields missing or extra in meta in graph.json\n");
+            if (currentKey == "nodes") return fail("Nodes is an array\n");
+            if (currentKey == "edges") return fail("Edges should be a array\n");
+            std::cerr << "Graph.json should have 3 correct parameters\n";
+            return true;
+        case Meta:
+        case NodeObject:
+        case EdgeObject:
+            if (field != EXTRA) {
+                Record& r = (state() == Meta) ? metaRecord : record;
+                v.present = true;
+                r[field] = std::move(v);
+            }
+            return true;
+        case Pois:
+            if (v.kind != Value::String) return fail("Fields in node > pois must be a string\n");
+            pois.push_back(std::move(v.s));
+            return true;
+        case Profile:
+            if (!v.number() || v.d <= 0) return fail("Edge speed profiles values must be number\n");
+            profile.push_back(v.d);
+            return true;
+        case Nodes: return fail("Fields missing or extra in nodes in graph.json\n");
+        case Edges: return fail("Fields missing or extra in edge in graph.json\n");
+        default: return true;
+        }
+    }
+
+    bool checkMeta() {
+        sawMeta = true;
+        Record& m = metaRecord;
+        if (!m[ID].present || !m[NODES].present || !m[DESCRIPTION].present || m.extra)
+            return fail("Fields missing or extra in meta in graph.json\n");
+        if (m[ID].kind != Value::String) return fail("Meta id must be a string\n");
+        if (!m[NODES].integer()) return fail("Meta nodes must be a integer\n");
+        if (m[DESCRIPTION].kind != Value::String) return fail("Meta description must be a string\n");
+        return true;
+    }
+
+    bool emitNode() {
+        Record& r = record;
+        if (!r[ID].present || !r[LAT].present || !r[LON].present || !r[POIS].present || r.extra)
+            return fail("Fields missing or extra in nodes in graph.json\n");
+        if (!r[ID].integer()) return fail("Node id must be a integer\n");
+        if (!r[LAT].number()) return fail("Node lat must be a float\n");
+        if (!r[LON].number()) return fail("Node lon must be a float\n");
+        if (r[POIS].kind != Value::Array) return fail("Fields in node > pois must be a string\n");
+
+        std::vector<int> tags;
+        tags.reserve(pois.size());
+        for (const std::string& t : pois)
+            tags.push_back(graph.internPoiTag(t));
+        graph.addNode(Node((int)r[ID].i, r[LAT].d, r[LON].d, tags));
+        return true;
+    }
+
+    bool emitEdge() {
+        Record& r = record;
+        for (int s = ID; s < PROFILE; s++)
+            if (!r[s].present) return fail("Fields missing or extra in edge in graph.json\n");
+        if (r.extra) return fail("Fields missing or extra in edge in graph.json\n");
+        if (!r[ID].integer()) return fail("Edge id must be a integer\n");
+        if (!r[U].integer()) return fail("Edge u must be a integer\n");
+        if (!r[V].integer()) return fail("Edge v must be a integer\n");
+        if (!r[LENGTH].number() || r[LENGTH].d <= 0) return fail("Edge length must be a float\n");
+        if (!r[TIME].number() || r[TIME].d <= 0) return fail("Edge average time must be a float\n");
+        if (r[ONEWAY].kind != Value::Bool) return fail("Egde oneway must be a boolean\n");
+        if (r[ROAD_TYPE].kind != Value::String) return fail("Edge road type must be a string\n");
+        // Edges without a speed_profile keep an empty one and follow their average_time
+        if (r[PROFILE].present) {
+            if (r[PROFILE].kind != Value::Array)
+                std::cerr << "Speed_profile is an array\n";
+            if (profile.size() != (size_t)SPEED_PROFILE_VALUES)
+                return fail("Edge speed profile must have 96 values\n");
+        }
+        int roadType = graph.internRoadType(r[ROAD_TYPE].s);
+        if (roadType < 0) return fail("Too many road types in graph.json\n");
+
+        int id = (int)r[ID].i;
+        graph.putEdge(Edge(id, (int)r[U].i, (int)r[V].i, r[LENGTH].d, r[TIME].d,
+                           r[ONEWAY].b, (uint8_t)roadType, graph.internProfile(profile, profiles)));
+        return true;
+    }
+
+    bool finish() {
+        if (!sawMeta) return fail("Fields missing or extra in meta in graph.json\n");
+        if (!sawNodes || !sawEdges) std::cerr << "Graph.json should have 3 correct parameters\n";
+        graph.buildCSR();
+        done = true;
+        return true;
+    }
+};
+
+// Parses graph.json straight into an empty graph. False, after printing the
+// reason, if the file is missing, malformed or fails validation
+inline bool load_graph_json(const std::string& path, Graph& graph) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    graph = Graph();
+    GraphSaxLoader loader(graph);
+    bool ok = json::sax_parse(file, &loader);
+    std::fclose(file);
+    if (ok && !loader.complete())
+        std::cerr << "Graph.json should have 3 correct parameters\n";
+    return ok && loader.complete();
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <cmath>
+#include <charconv>
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Serializes results straight into a reusable buffer instead of building a json
+// object per result and dumping it. Pretty mode matches dump(4) line for line;
+// compact mode puts each result on one line. The buffer goes to the stream in
+// large blocks, or after every result when the caller asks for it.
+class ResultWriter {
+public:
+    static constexpr size_t BLOCK = 1 << 20;
+
+    ResultWriter(std::ostream& out, bool pretty = true) : out(&out), pretty(pretty) {
+        buffer.reserve(BLOCK + BLOCK / 4);
+    }
+
+    // Without a stream results stay in memory until append() moves them elsewhere
+    explicit ResultWriter(bool pretty) : out(nullptr), pretty(pretty) {}
+
+    ~ResultWriter() { flush(); }
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    bool isPretty() const { return pretty; }
+
+    void beginObject() {
+        buffer += '{';
+        first = true;
+        depth++;
+    }
+
+    // Closes the object; a top-level result ends its line and may trigger a flush
+    void endObject() {
+        depth--;
+        if (!first) newline();
+        buffer += '}';
+        first = false;
+        if (depth == 0) {
+            buffer += '\n';
+            if (buffer.size() >= BLOCK) flush();
+        }
+    }
+
+    ResultWriter& key(const char* name) {
+        if (!first) buffer += ',';
+        first = false;
+        newline();
+        string(name);
+        buffer += pretty ? ": " : ":";
+        return *this;
+    }
+
+    void value(bool b) { buffer += b ? "true" : "false"; }
+    void value(int i) { integer(i); }
+    void value(long long i) { integer(i); }
+    void value(double d) { number(d); }
+    void value(const char* s) { string(s); }
+    void value(const std::string& s) { string(s.c_str(), s.size()); }
+
+    // Arbitrary json, e.g. an id copied from the query; only scalars stay on one line
+    void value(const json& j) {
+        if (j.is_structured() && pretty) buffer += j.dump(4);
+        else buffer += j.dump();
+    }
+
+    template <typename T>
+    void value(const std::vector<T>& items) { array(items.data(), items.size()); }
+    template <typename T, size_t N>
+    void value(const std::array<T, N>& items) { array(items.data(), N); }
+
+    template <typename T>
+    void field(const char* name, const T& v) { key(name).value(v); }
+
+    // Copies bytes [begin, end) of part, e.g. one result out of a batch
+    void append(const ResultWriter& part, size_t begin, size_t end) {
+        buffer.append(part.buffer, begin, end - begin);
+        if (buffer.size() >= BLOCK) flush();
+    }
+
+    size_t size() const { return buffer.size(); }
+    void clear() { buffer.clear(); }
+
+    void flush() {
+        if (!out || buffer.empty()) return;
+        out->write(buffer.data(), (std::streamsize)buffer.size());
+        buffer.clear();
+    }
+
+    // Flushes the buffer and the stream itself, for results that must show up now
+    void sync() {
+        flush();
+        if (out) out->flush();
+    }
+
+private:
+    std::ostream* out;
+    bool pretty;
+    std::string buffer;
+    int depth = 0;
+    bool first = true;
+
+    void newline() {
+        if (!pretty) return;
+        buffer += '\n';
+        buffer.append((size_t)depth * 4, ' ');
+    }
+
+    template <typename T>
+    void array(const T* items, size_t count) {
+        buffer += '[';
+        if (count == 0) {
+            buffer += ']';
+            return;
+        }
+        depth++;
+        for (size_t i = 0; i < count; i++) {
+            if (i) buffer += ',';
+            newline();
+            value(items[i]);
+        }
+        depth--;
+        newline();
+        buffer += ']';
+    }
+
+    template <typename T>
+    void integer(T i) {
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof tmp, i);
+        buffer.append(tmp, res.ptr);
+    }
+
+    // Shortest round-trip form like dump(); integral values keep a ".0" so they
+    // read back as floats, and non-finite values become null
+    void number(double d) {
+        if (!std::isfinite(d)) {
+            buffer += "null";
+            return;
+        }
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof tmp, d);
+        bool integral = true;
+        for (char* p = tmp; p != res.ptr; p++) {
+            if (*p == '.' || *p == 'e' || *p == 'n' || *p == 'i') {
+                integral = false;
+                break;
+            }
+        }
+        buffer.append(tmp, res.ptr);
+        if (integral) buffer += ".0";
+    }
+
+    void string(const char* s) { string(s, std::char_traits<char>::length(s)); }
+
+    void string(const char* s, size_t n) {
+        static const char hex[] = "0123456789abcdef";
+        buffer += '"';
+        for (size_t i = 0; i < n; i++) {
+            unsigned char c = (unsigned char)s[i];
+            switch (c) {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            case '\b': buffer += "\\b"; break;
+            case '\f': buffer += "\\f"; break;
+            default:
+                if (c < 0x20) {
+                    buffer += "\\u00";
+                    buffer += hex[c >> 4];
+                    buffer += hex[c & 15];
+                }
+                else buffer += (char)c;
+            }
+        }
+        buffer += '"';
+    }
+};
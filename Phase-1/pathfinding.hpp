@@ -1,13 +1,14 @@
 #pragma once
 
 #include <unordered_map>
-#include <unordered_set>
 #include <queue>
 #include <vector>
 #include <cmath>
 #include <limits>
 #include <algorithm>
 #include "Graph.hpp"
+#include "workspace.hpp"
+#include "alt.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
@@ -18,11 +19,12 @@ inline double deg_to_rad(double deg) {
     return deg * M_PI / 180.0;
 }
 
-double haversine_distance(const Node& a, const Node& b) {
-    double lat1 = deg_to_rad(a.lat);
-    double lon1 = deg_to_rad(a.lon);
-    double lat2 = deg_to_rad(b.lat);
-    double lon2 = deg_to_rad(b.lon);
+// Great-circle distance in meters between two points given in degrees
+inline double haversine_distance(double lat_a, double lon_a, double lat_b, double lon_b) {
+    double lat1 = deg_to_rad(lat_a);
+    double lon1 = deg_to_rad(lon_a);
+    double lat2 = deg_to_rad(lat_b);
+    double lon2 = deg_to_rad(lon_b);
 
     double dlat = lat2 - lat1;
     double dlon = lon2 - lon1;
@@ -34,121 +36,237 @@ double haversine_distance(const Node& a, const Node& b) {
     return 2 * EARTH_RADIUS * std::asin(std::sqrt(h));
 }
 
+double haversine_distance(const Node& a, const Node& b) {
+    return haversine_distance(a.lat, a.lon, b.lat, b.lon);
+}
+
 double heuristic(const Node& a, const Node& b) {
     return haversine_distance(a, b);
 }
 
-inline std::pair<bool, json> shortest_path(
-    Graph& graph,
+// Lower bound on the cost from one node to another for a query from source to
+// target. Landmarks bound both metrics; without them haversine meters only bound
+// distances, and time falls back to zero (plain Dijkstra order) rather than
+// mixing units
+struct Potential {
+    static constexpr int ACTIVE_LANDMARKS = 4;
+
+    const Graph& graph;
+    const Landmarks* landmarks;
+    int metric;
+    int active[ACTIVE_LANDMARKS];
+    int activeCount = 0;
+
+    Potential(const Graph& graph, const Landmarks* landmarks, const std::string& mode, int source, int target)
+        : graph(graph), metric(mode == "distance" ? 0 : 1) {
+        this->landmarks = (landmarks && landmarks->usable(metric)) ? landmarks : nullptr;
+        if (this->landmarks)
+            activeCount = this->landmarks->select(metric, source, target, active, ACTIVE_LANDMARKS);
+    }
+
+    bool informed() const { return landmarks || metric == 0; }
+
+    double operator()(int from, int to) const {
+        if (landmarks) return landmarks->lowerBound(metric, from, to, active, activeCount);
+        return metric == 0 ? heuristic(graph.nodes[from], graph.nodes[to]) : 0.0;
+    }
+};
+
+// Result of a point-to-point search, path holds dense node indices
+struct PathResult {
+    bool found = false;
+    double cost = 0.0;
+    std::vector<int> path;
+};
+
+// A* over dense node indices. Callers translate node ids with Graph::index
+inline PathResult shortest_path(
+    const Graph& graph,
+    SearchWorkspace& ws,
     int source,
     int target,
     const std::string& mode,
-    const std::unordered_set<int>& forbidden_nodes,
-    const std::unordered_set<std::string>& forbidden_road_types
+    const std::vector<int>& forbidden_nodes,
+    const RoadTypeMask& forbidden_road_types,
+    const Landmarks* landmarks = nullptr
 ) {
-    if (!graph.nodes.count(source) || !graph.nodes.count(target)) {
-        return {false, {}};
+    const int n = graph.numNodes();
+    if (source < 0 || source >= n || target < 0 || target >= n) {
+        return {};
     }
 
     if (mode != "distance" && mode != "time") {
-        return {false, {}};
+        return {};
     }
 
-    struct State {
-        int node;
-        double cost;
-        double est_total;
-        bool operator>(const State& other) const {
-            return est_total > other.est_total;
-        }
-    };
-
-    std::priority_queue<State, std::vector<State>, std::greater<State>> pq;
-    std::unordered_map<int, double> g_cost;
-    std::unordered_map<int, int> parent;
-    std::unordered_set<int> closed_set;
+    SearchWorkspace::Side& search = ws.forward;
+    search.reset(n);
+    ws.resetBlocked(n);
+    for (int f : forbidden_nodes)
+        ws.block(f);
 
-    for (auto& [id, node] : graph.nodes)
-        g_cost[id] = std::numeric_limits<double>::infinity();
+    const Potential potential(graph, landmarks, mode, source, target);
+    const ArcWeights& weight = (mode == "distance") ? graph.arcLength : graph.arcTime;
 
-    g_cost[source] = 0.0;
-    pq.push({source, 0.0, heuristic(graph.nodes[source], graph.nodes[target])});
+    search.label(source, 0.0, -1);
+    search.push(potential(source, target), source);
 
-    while (!pq.empty()) {
-        auto [u, cost_u, est_total] = pq.top();
-        pq.pop();
+    while (!search.empty()) {
+        int u = search.pop().node;
 
-        if (closed_set.count(u))
+        if (search.settled(u))
             continue;
-        closed_set.insert(u);
+        search.settle(u);
 
-        if (forbidden_nodes.count(u))
+        if (ws.blocked(u))
             continue;
 
         if (u == target) {
-            if (!parent.count(target) && source != target)
-                return {false, {}};
+            PathResult result;
+            for (int curr = target; curr != -1; curr = search.parentOf(curr))
+                result.path.push_back(curr);
+            std::reverse(result.path.begin(), result.path.end());
+
+            result.found = true;
+            result.cost = search.distance(target);
+            return result;
+        }
 
-            std::vector<int> path;
-            for (int curr = target; curr != source; curr = parent[curr])
-                path.push_back(curr);
-            path.push_back(source);
-            std::reverse(path.begin(), path.end());
+        double cost_u = search.distance(u);
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            if (!graph.arcAllowed(a, forbidden_road_types)) continue;
+            if (ws.blocked(v)) continue;
 
-            double total_cost = g_cost[target];
-            json result;
+            double new_cost = cost_u + weight[a];
 
-            if (mode == "distance")
-                result["minimum_distance"] = total_cost;
-            else
-                result["minimum_time"] = total_cost;
+            if (new_cost + 1e-9 < search.distance(v)) {
+                search.label(v, new_cost, u);
 
-            result["path"] = path;
-            return {true, result};
+                search.push(new_cost + potential(v, target), v);
+            }
         }
+    }
+    return {};
+}
+
+
+// Bidirectional search: forward from source over the CSR, backward from target
+// over the reverse CSR. Both sides use the average of the forward and backward
+// potentials (bidirectional A*); in time mode without landmarks the potential
+// is zero (bidirectional Dijkstra).
+inline PathResult bidirectional_shortest_path(
+    const Graph& graph,
+    SearchWorkspace& ws,
+    int source,
+    int target,
+    const std::string& mode,
+    const std::vector<int>& forbidden_nodes,
+    const RoadTypeMask& forbidden_road_types,
+    const Landmarks* landmarks = nullptr
+) {
+    const int n = graph.numNodes();
+    if (source < 0 || source >= n || target < 0 || target >= n) {
+        return {};
+    }
+
+    if (mode != "distance" && mode != "time") {
+        return {};
+    }
+
+    ws.resetBlocked(n);
+    for (int f : forbidden_nodes)
+        ws.block(f);
+    if (ws.blocked(source) || ws.blocked(target))
+        return {};
+
+    const Potential bound(graph, landmarks, mode, source, target);
+    auto potential = [&](int v) {
+        if (!bound.informed()) return 0.0;
+        return (bound(v, target) - bound(source, v)) / 2;
+    };
+
+    const ArcWeights& weight = (mode == "distance") ? graph.arcLength : graph.arcTime;
 
-        for (auto& edge : graph.adjList[u]) {
-            if (!graph.nodes.count(edge.v)) continue;
-            if (forbidden_road_types.count(edge.road_type)) continue;
-            if (forbidden_nodes.count(edge.v)) continue;
+    SearchWorkspace::Side& fwd = ws.forward;
+    SearchWorkspace::Side& bwd = ws.backward;
+    fwd.reset(n);
+    bwd.reset(n);
+    fwd.label(source, 0.0, -1);
+    fwd.push(potential(source), source);
+    bwd.label(target, 0.0, -1);
+    bwd.push(-potential(target), target);
 
-            double edge_cost = (mode == "distance") ? edge.length : edge.average_time;
-            double new_cost = g_cost[u] + edge_cost;
+    double best = (source == target) ? 0.0 : std::numeric_limits<double>::infinity();
+    int meet = (source == target) ? source : -1;
 
-            if (new_cost + 1e-9 < g_cost[edge.v]) {
-                g_cost[edge.v] = new_cost;
-                parent[edge.v] = u;
+    bool turn = true;
+    while (!fwd.empty() && !bwd.empty()) {
+        // Keys are distance +/- potential, so the usual sum rule still proves optimality
+        if (fwd.top().key + bwd.top().key >= best)
+            break;
 
-                double h = heuristic(graph.nodes[edge.v], graph.nodes[target]);
-                pq.push({edge.v, new_cost, new_cost + h});
+        bool forward = turn;
+        turn = !turn;
+        SearchWorkspace::Side& self = forward ? fwd : bwd;
+        SearchWorkspace::Side& other = forward ? bwd : fwd;
+
+        int u = self.pop().node;
+        if (self.settled(u))
+            continue;
+        self.settle(u);
+        double du = self.distance(u);
+
+        auto relax = [&](int v, int arc) {
+            if (ws.blocked(v) || !graph.arcAllowed(arc, forbidden_road_types)) return;
+            double nd = du + weight[arc];
+            if (nd < self.distance(v)) {
+                self.label(v, nd, u);
+                self.push(nd + (forward ? potential(v) : -potential(v)), v);
             }
+            if (other.reached(v) && self.distance(v) + other.distance(v) < best) {
+                best = self.distance(v) + other.distance(v);
+                meet = v;
+            }
+        };
+
+        if (forward) {
+            for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++)
+                relax(graph.arcTarget[a], a);
+        } else {
+            for (int r = graph.revOffsets[u]; r < graph.revOffsets[u + 1]; r++)
+                relax(graph.revSource[r], graph.revArc[r]);
         }
     }
-    return {false, {}};
+
+    if (meet < 0)
+        return {};
+
+    PathResult result;
+    for (int v = meet; v != -1; v = fwd.parentOf(v))
+        result.path.push_back(v);
+    std::reverse(result.path.begin(), result.path.end());
+    for (int v = bwd.parentOf(meet); v != -1; v = bwd.parentOf(v))
+        result.path.push_back(v);
+
+    result.found = true;
+    result.cost = best;
+    return result;
 }
 
 
+// Both kNN searches return dense node indices, nearest first. poi_tag is an
+// id from graph.poiTags
 std::vector<int> knn_euclidean(const Graph& graph,
-                               int source_node_id,
                                double query_lat,
                                double query_lon,
-                               const std::string& poi_type,
+                               int poi_tag,
                                int k) {
-    if (!graph.nodes.count(source_node_id))
-        return {};
-
     std::priority_queue<std::pair<double, int>> pq;
 
-    for (auto& [node_id, node] : graph.nodes) {
-        bool is_poi = false;
-        for (auto& t : node.pois) {
-            if (t == poi_type) {
-                is_poi = true;
-                break;
-            }
-        }
-        if (!is_poi) continue;
-
+    // Only nodes carrying the tag are candidates
+    for (int node_id : graph.poiNodes[poi_tag]) {
+        const Node& node = graph.nodes[node_id];
         double dx = node.lon - query_lon;
         double dy = node.lat - query_lat;
         double dist = std::sqrt(dx * dx + dy * dy);
@@ -167,36 +285,67 @@ std::vector<int> knn_euclidean(const Graph& graph,
     return result;
 }
 
+// Geodesic kNN by linear scan: (meters, dense index) pairs, nearest first
+std::vector<std::pair<double, int>> knn_geodesic(const Graph& graph,
+                                                 double query_lat,
+                                                 double query_lon,
+                                                 int poi_tag,
+                                                 int k) {
+    std::priority_queue<std::pair<double, int>> pq;
+    for (int node_id : graph.poiNodes[poi_tag]) {
+        const Node& node = graph.nodes[node_id];
+        pq.push({haversine_distance(query_lat, query_lon, node.lat, node.lon), node_id});
+        if ((int)pq.size() > k)
+            pq.pop();
+    }
+
+    std::vector<std::pair<double, int>> result;
+    while (!pq.empty()) {
+        result.push_back(pq.top());
+        pq.pop();
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+// Dense index of the routable node nearest to a point in great-circle meters,
+// -1 if there is none. Linear scan, for when no SnapIndex is built
+int snap_to_node(const Graph& graph, double lat, double lon) {
+    std::pair<double, int> best(std::numeric_limits<double>::infinity(), -1);
+    for (int v = 0; v < graph.numNodes(); v++) {
+        if (!graph.routable(v)) continue;
+        const Node& node = graph.nodes[v];
+        best = std::min(best, {haversine_distance(lat, lon, node.lat, node.lon), v});
+    }
+    return best.second;
+}
+
 std::vector<int> knn_shortest_path(const Graph& graph,
-                                   int source_node_id,
-                                   const std::string& poi_type,
+                                   SearchWorkspace& ws,
+                                   int source,
+                                   int poi_tag,
                                    int k) {
-    if (!graph.nodes.count(source_node_id))
+    const int n = graph.numNodes();
+    if (source < 0 || source >= n)
         return {};
 
-    std::unordered_map<int, double> dist;
-    for (auto& [id, _] : graph.nodes)
-        dist[id] = std::numeric_limits<double>::infinity();
-
-    using PDI = std::pair<double, int>;
-    std::priority_queue<PDI, std::vector<PDI>, std::greater<PDI>> pq;
-    dist[source_node_id] = 0.0;
-    pq.push({0.0, source_node_id});
+    SearchWorkspace::Side& search = ws.forward;
+    search.reset(n);
+    search.label(source, 0.0, -1);
+    search.push(0.0, source);
 
     std::priority_queue<std::pair<double, int>> nearest_pois;
     double max_found_dist = std::numeric_limits<double>::infinity();
 
-    while (!pq.empty()) {
-        auto [d, u] = pq.top();
-        pq.pop();
+    while (!search.empty()) {
+        auto [d, u] = search.pop();
 
         if (!nearest_pois.empty() && d > max_found_dist)
             break;
 
-        if (d > dist[u]) continue;
+        if (d > search.distance(u)) continue;
 
-        if (std::find(graph.nodes.at(u).pois.begin(), graph.nodes.at(u).pois.end(), poi_type)
-            != graph.nodes.at(u).pois.end()) {
+        if (graph.hasPoi(u, poi_tag)) {
             nearest_pois.push({d, u});
             if ((int)nearest_pois.size() > k)
                 nearest_pois.pop();
@@ -204,11 +353,12 @@ std::vector<int> knn_shortest_path(const Graph& graph,
                 max_found_dist = nearest_pois.top().first;
         }
 
-        for (const auto& edge : graph.adjList.at(u)) {
-            double new_dist = d + edge.length;
-            if (new_dist < dist[edge.v]) {
-                dist[edge.v] = new_dist;
-                pq.push({new_dist, edge.v});
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            double new_dist = d + graph.arcLength[a];
+            if (new_dist < search.distance(v)) {
+                search.label(v, new_dist, u);
+                search.push(new_dist, v);
             }
         }
     }
@@ -2,65 +2,185 @@
 #include <fstream>
 #include <chrono>
 #include <filesystem>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
 #include "Graph.hpp"
 #include "json.hpp"
 #include "check.hpp"
 #include "handle.hpp"
+#include "snapshot.hpp"
+#include "loader.hpp"
+#include "output.hpp"
+#include "executor.hpp"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
 int main(int argc, char* argv[]) {
-    if (argc != 3 || fs::path(argv[1]).extension() != ".json" || fs::path(argv[2]).extension() != ".json") {
-        std::cerr << "Usage: " << argv[0] << " <graph.json> <queries.json>" << std::endl;
-        return 1;
+    // Snapshot mode converts graph.json once and exits
+    if (argc == 4 && std::string(argv[1]) == "--snapshot") {
+        Graph graph;
+        if (!load_graph_json(argv[2], graph))
+            return 1;
+        if (!save_snapshot(argv[3], graph)) {
+            std::cerr << "Failed to write " << argv[3] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Optional flags follow the two input files
+    std::string ch_path;
+    bool use_crp = false;
+    bool use_alt = false;
+    bool knn_buckets = false;
+    bool bidirectional = false;
+    bool stream = false;
+    bool compact = false;
+    int threads = 1;
+    std::string output_path = "output.json";
+    bool bad_args = argc < 3;
+    for (int i = 3; i < argc && !bad_args; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ch" && i + 1 < argc)
+            ch_path = argv[++i];
+        else if (arg == "--output" && i + 1 < argc)
+            output_path = argv[++i];
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg == "--compact")
+            compact = true;
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--crp")
+            use_crp = true;
+        else if (arg == "--alt")
+            use_alt = true;
+        else if (arg == "--knn-buckets")
+            knn_buckets = true;
+        else if (arg == "--bidirectional")
+            bidirectional = true;
+        else
+            bad_args = true;
     }
 
-    // --- Load graph.json ---
-    std::ifstream graph_file(argv[1]);
-    if (!graph_file.is_open()) {
-        std::cerr << "Failed to open " << argv[1] << std::endl;
+    // Queries come as one queries.json document, or as NDJSON: one event per
+    // line, from a .ndjson file or from stdin when the path is "-"
+    std::string graph_ext = bad_args ? "" : fs::path(argv[1]).extension().string();
+    std::string queries_ext = bad_args ? "" : fs::path(argv[2]).extension().string();
+    bool ndjson = !bad_args && (std::string(argv[2]) == "-" || queries_ext == ".ndjson");
+    if (bad_args || (graph_ext != ".json" && graph_ext != ".snap") || (queries_ext != ".json" && !ndjson)) {
+        std::cerr << "Usage: " << argv[0] << " <graph.json|graph.snap> <queries.json|queries.ndjson|-> [--ch <hierarchy file> [--knn-buckets]] [--crp] [--alt] [--bidirectional] [--stream] [--compact] [--threads <n>] [--output <file|->]\n"
+                  << "       " << argv[0] << " --snapshot <graph.json> <graph.snap>" << std::endl;
         return 1;
     }
-    json graphJson;
-    graph_file >> graphJson;
+    // NDJSON is always answered line by line
+    stream = stream || ndjson;
+    // 0 threads means one per core
+    if (threads <= 0)
+        threads = (int)std::max(1u, std::thread::hardware_concurrency());
 
-    if (!check_graph(graphJson))
+    // --- Load the graph: a binary snapshot is mapped, graph.json is streamed ---
+    Graph graph;
+    if (graph_ext == ".snap") {
+        if (!load_snapshot(argv[1], graph)) {
+            std::cerr << "Failed to load snapshot " << argv[1] << std::endl;
+            return 1;
+        }
+    }
+    else if (!load_graph_json(argv[1], graph))
         return 1;
 
-    // --- Construct nodes and edges ---
-    std::vector<Node> nodes;
-    std::vector<Edge> edges;
-
-    for (auto& node : graphJson["nodes"]) {
-        Node n(
-            node["id"],
-            node["lat"],
-            node["lon"],
-            node["pois"].get<std::vector<std::string>>()
-        );
-        nodes.emplace_back(std::move(n));
+    // --- Contraction hierarchies: reuse the file if it matches, else preprocess and save ---
+    Accelerators accel;
+    accel.bidirectional = bidirectional;
+    if (!ch_path.empty()) {
+        accel.chDistance = std::make_unique<ContractionHierarchy>();
+        accel.chTime = std::make_unique<ContractionHierarchy>();
+        if (!load_hierarchies(ch_path, graph, *accel.chDistance, *accel.chTime)) {
+            *accel.chDistance = ContractionHierarchy::build(graph, graph.arcLength);
+            *accel.chTime = ContractionHierarchy::build(graph, graph.arcTime);
+            if (!save_hierarchies(ch_path, *accel.chDistance, *accel.chTime))
+                std::cerr << "Failed to write " << ch_path << std::endl;
+        }
     }
 
-    for (auto& edge : graphJson["edges"]) {
-        if (!edge.contains("speed_profile")) {
-            edge["speed_profile"] = std::vector<double>(96, edge["length"].get<double>() / edge["average_time"].get<double>());
+    // --- kNN buckets for sparse POI tags on the distance hierarchy ---
+    if (knn_buckets && !accel.chDistance)
+        std::cerr << "--knn-buckets needs --ch, kNN falls back to Dijkstra" << std::endl;
+    if (knn_buckets && accel.chDistance)
+        accel.poiBuckets = std::make_unique<PoiBuckets>(graph, *accel.chDistance);
+
+    // --- Partition overlay, customized now and again after every edge update ---
+    if (use_crp)
+        accel.crp = std::make_unique<CRPOverlay>(graph);
+
+    // --- Landmark distances for the A* bounds ---
+    if (use_alt)
+        accel.landmarks = std::make_unique<Landmarks>(graph);
+
+    // --- k-d trees: per POI tag for kNN, over all nodes for snapping coordinates ---
+    accel.poiIndex = std::make_unique<PoiSpatialIndex>(graph);
+    accel.snapIndex = std::make_unique<SnapIndex>(graph);
+
+    // --- Open the output, output.json unless --output says otherwise ("-" is stdout) ---
+    std::ofstream output_file;
+    if (output_path != "-") {
+        output_file.open(output_path);
+        if (!output_file.is_open()) {
+            std::cerr << "Failed to open " << output_path << " for writing" << std::endl;
+            return 1;
         }
-        Edge e(
-            edge["id"],
-            edge["u"],
-            edge["v"],
-            edge["length"],
-            edge["average_time"],
-            edge["oneway"],
-            edge["road_type"],
-            edge["speed_profile"].get<std::vector<double>>(),
-            false
-        );
-        edges.emplace_back(std::move(e));
     }
+    std::ostream& output = output_path == "-" ? std::cout : output_file;
+    // Pretty results match dump(4); --compact writes one result per line
+    ResultWriter writer(output, !compact);
+
+    // Reads between two updates run across the threads. A batch run waits for
+    // the whole epoch; a streamed one answers each event on arrival when single
+    // threaded, otherwise in small batches so the workers have something to share
+    QueryExecutor executor(graph, accel, writer, threads, stream ? (size_t)(threads == 1 ? 1 : 16 * threads) : 0, stream);
 
-    Graph graph(nodes, edges);
+    // --- NDJSON: parse, check and answer one line at a time ---
+    if (ndjson) {
+        std::ifstream queries_file;
+        if (std::string(argv[2]) != "-") {
+            queries_file.open(argv[2]);
+            if (!queries_file.is_open()) {
+                std::cerr << "Failed to open " << argv[2] << std::endl;
+                return 1;
+            }
+        }
+        std::istream& input = std::string(argv[2]) == "-" ? std::cin : queries_file;
+
+        std::string line;
+        for (int line_no = 1; std::getline(input, line); line_no++) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            json event = json::parse(line, nullptr, false);
+            if (event.is_discarded()) {
+                std::cerr << "Invalid JSON on line " << line_no << " of " << argv[2] << "\n";
+                executor.finish();
+                return 1;
+            }
+            // An optional {"meta": {...}} line carries the id queries.json would have
+            if (event.is_object() && event.size() == 1 && event.contains("meta")) {
+                if (!check_query_meta(event["meta"])) {
+                    executor.finish();
+                    return 1;
+                }
+                continue;
+            }
+            if (!check_event(event)) {
+                executor.finish();
+                return 1;
+            }
+            executor.submit(std::move(event));
+        }
+        executor.finish();
+        return 0;
+    }
 
     // --- Load queries.json ---
     std::ifstream queries_file(argv[2]);
@@ -68,6 +188,55 @@ int main(int argc, char* argv[]) {
         std::cerr << "Failed to open " << argv[2] << std::endl;
         return 1;
     }
+
+    // --- Streamed queries.json: each event is checked and answered as soon as
+    // its object closes, then dropped instead of being kept in the document ---
+    if (stream) {
+        std::string top_key;
+        bool failed = false;
+        json::parser_callback_t on_event = [&](int depth, json::parse_event_t event, json& parsed) {
+            if (depth == 1 && event == json::parse_event_t::key) {
+                top_key = parsed.get<std::string>();
+                return true;
+            }
+            if (depth == 1 && event == json::parse_event_t::object_end && top_key == "meta") {
+                if (!failed && !check_query_meta(parsed))
+                    failed = true;
+                return true;
+            }
+            if (depth != 2 || top_key != "events")
+                return true;
+            if (event != json::parse_event_t::object_end && event != json::parse_event_t::array_end &&
+                event != json::parse_event_t::value)
+                return true;
+
+            // Later events are still parsed but no longer answered after a bad one
+            if (!failed && !check_event(parsed))
+                failed = true;
+            if (!failed)
+                executor.submit(std::move(parsed));
+            return false;
+        };
+
+        json queriesJson = json::parse(queries_file, on_event, false);
+        executor.finish();
+        if (queriesJson.is_discarded()) {
+            std::cerr << "Invalid queries.json\n";
+            return 1;
+        }
+        if (failed)
+            return 1;
+        if (!queriesJson.contains("meta") || !queriesJson.contains("events") || queriesJson.size() != 2) {
+            std::cerr << "Missing or Extra 'meta' or 'events' in queries.json\n";
+            return 1;
+        }
+        if (!queriesJson["events"].is_array()) {
+            std::cerr << "'events' must be an array\n";
+            return 1;
+        }
+        return 0;
+    }
+
     json queriesJson;
     queries_file >> queriesJson;
 
@@ -79,27 +248,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // --- Open output.json ---
-    std::ofstream output_file("output.json");
-    if (!output_file.is_open()) {
-        std::cerr << "Failed to open output.json for writing" << std::endl;
-        return 1;
-    }
-
     // --- Process each query in events ---
-   for (const auto& query : queriesJson["events"]) {
-        auto start_time = std::chrono::high_resolution_clock::now();
-
-        json result = process_query(query, graph);
-
-        auto end_time = std::chrono::high_resolution_clock::now();
-        result["processing_time"] =
-            std::chrono::duration<double, std::milli>(end_time - start_time).count();
-
-        output_file << result.dump(4) << '\n';
-    }
-
+    for (auto& query : queriesJson["events"])
+        executor.submit(std::move(query));
+    executor.finish();
 
+    writer.flush();
     output_file.close();
     return 0;
 }
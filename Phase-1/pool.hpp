@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+// Fixed set of worker threads that run one parallel loop at a time. The calling
+// thread takes part as worker 0, so a pool of size 1 starts no threads at all.
+//
+// Items are dealt out in contiguous runs, one per worker deque. A worker takes
+// from the front of its own deque and, once that is empty, steals from the back
+// of a randomly chosen victim, so a few expensive items cannot leave the other
+// workers idle while one deque still holds a backlog.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) : workers(std::max(1, threads)), queues(workers) {
+        for (int w = 1; w < workers; w++)
+            threads_.emplace_back([this, w]() { loop(w); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads_)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return workers; }
+
+    // Calls body(worker, item) once for every item in [0, count), on whichever
+    // worker gets to it; returns once all items are done
+    void run(int count, const std::function<void(int, int)>& body) {
+        if (workers == 1 || count <= 1) {
+            for (int i = 0; i < count; i++)
+                body(0, i);
+            return;
+        }
+        for (int w = 0; w < workers; w++) {
+            Queue& q = queues[w];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            int begin = (int)((long long)count * w / workers);
+            int end = (int)((long long)count * (w + 1) / workers);
+            for (int i = begin; i < end; i++)
+                q.items.push_back(i);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &body;
+            pending = workers - 1;
+            round++;
+        }
+        wake.notify_all();
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> items;
+    };
+
+    int workers;
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads_;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    const std::function<void(int, int)>* job = nullptr;
+    int pending = 0;// helper threads still inside the current round
+    unsigned round = 0;
+    bool stopping = false;
+
+    bool take(int w, int& item) {
+        Queue& q = queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.items.empty()) return false;
+        item = q.items.front();
+        q.items.pop_front();
+        return true;
+    }
+
+    bool steal(int victim, int& item) {
+        Queue& q = queues[victim];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.items.empty()) return false;
+        item = q.items.back();
+        q.items.pop_back();
+        return true;
+    }
+
+    // Runs items until none are left anywhere. Items are only dealt out before
+    // a round starts, so once a full pass over the other deques comes up empty
+    // there is nothing left to wait for: the worker leaves and sleeps on wake
+    // (or, as worker 0, on finished) while the items in flight finish
+    void work(int w) {
+        std::minstd_rand rng(w * 7919 + round);
+        std::uniform_int_distribution<int> pick(1, workers - 1);
+        int item;
+        while (true) {
+            bool found = take(w, item);
+            // Start at a random victim so thieves spread out, but try them all
+            int first = pick(rng);
+            for (int i = 0; !found && i < workers - 1; i++)
+                found = steal((w + (first + i - 1) % (workers - 1) + 1) % workers, item);
+            if (!found) return;
+            (*job)(w, item);
+        }
+    }
+
+    void loop(int w) {
+        unsigned seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || round != seen; });
+                if (stopping) return;
+                seen = round;
+            }
+            work(w);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) finished.notify_one();
+            }
+        }
+    }
+};
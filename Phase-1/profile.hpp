@@ -0,0 +1,181 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <algorithm>
+#include "Graph.hpp"
+#include "timedep.hpp"
+#include "workspace.hpp"
+
+// Profile queries: travel time from source to target for every departure slot
+// of the day, found by one label-correcting search whose labels are whole
+// profiles instead of single numbers.
+
+constexpr int PROFILE_SLOTS = 96;
+constexpr double PROFILE_SLOT_SECONDS = DAY_SECONDS / PROFILE_SLOTS;
+
+// Travel time from the source for departures at i * PROFILE_SLOT_SECONDS.
+// Sampling at the slots instead of keeping exact breakpoints keeps linking and
+// merging at a fixed cost: composed speed profiles gain breakpoints on every
+// edge, while the answer is only ever read at the slots.
+using Profile = std::array<double, PROFILE_SLOTS>;
+
+// h[i] = f[i] + travel time of the arc entered at the arrival time of slot i
+inline Profile profile_link(const Graph& graph, const Profile& f, int arc) {
+    Profile h;
+    for (int i = 0; i < PROFILE_SLOTS; i++)
+        h[i] = f[i] + arc_travel_time(graph, arc, i * PROFILE_SLOT_SECONDS + f[i]);
+    return h;
+}
+
+// f = min(f, g) slot by slot; true if g is lower anywhere
+inline bool profile_merge(Profile& f, const Profile& g) {
+    bool improved = false;
+    for (int i = 0; i < PROFILE_SLOTS; i++) {
+        if (g[i] < f[i]) {
+            f[i] = g[i];
+            improved = true;
+        }
+    }
+    return improved;
+}
+
+struct ProfileResult {
+    bool found = false;
+    Profile travel{};
+};
+
+// Static Dijkstra on the per-arc bounds of the travel-time functions (TtfRef::lo
+// or hi), forward from `from` or backward over the reverse CSR. Stops once `stop`
+// is settled or distances pass `limit`; returns the distance to `stop`
+inline double bound_search(
+    const Graph& graph,
+    SearchWorkspace& ws,
+    SearchWorkspace::Side& side,
+    int from,
+    int stop,
+    bool backward,
+    bool upper,
+    double limit,
+    const RoadTypeMask& forbidden_road_types
+) {
+    side.reset(graph.numNodes());
+    side.label(from, 0.0, -1);
+    side.push(0.0, from);
+    while (!side.empty()) {
+        auto [d, u] = side.pop();
+        if (side.settled(u)) continue;
+        side.settle(u);
+        if (u == stop) return d;
+        if (d > limit) break;
+
+        const std::vector<int>& offsets = backward ? graph.revOffsets : graph.offsets;
+        for (int k = offsets[u]; k < offsets[u + 1]; k++) {
+            int a = backward ? graph.revArc[k] : k;
+            int v = backward ? graph.revSource[k] : graph.arcTarget[k];
+            if (!std::isfinite(graph.arcTime[a]) || ws.blocked(v)) continue;
+            if (!graph.arcAllowed(a, forbidden_road_types)) continue;
+
+            double nd = d + (upper ? graph.arcTtf[a].hi : graph.arcTtf[a].lo);
+            if (nd < side.distance(v)) {
+                side.label(v, nd, u);
+                side.push(nd, v);
+            }
+        }
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+// Nodes are ordered by the fastest slot of their profile plus a lower bound to
+// the target, and a profile is dropped once that sum exceeds `bound`, a travel
+// time the target is known to reach for every slot (first from the static path
+// over upper bounds, then from the target's own profile)
+inline ProfileResult profile_search(
+    const Graph& graph,
+    SearchWorkspace& ws,
+    int source,
+    int target,
+    const std::vector<int>& forbidden_nodes,
+    const RoadTypeMask& forbidden_road_types
+) {
+    const int n = graph.numNodes();
+    if (source < 0 || source >= n || target < 0 || target >= n)
+        return {};
+
+    ws.resetBlocked(n);
+    for (int f : forbidden_nodes)
+        ws.block(f);
+    if (ws.blocked(source) || ws.blocked(target))
+        return {};
+
+    double bound = bound_search(graph, ws, ws.backward, source, target, false, true,
+                                std::numeric_limits<double>::infinity(), forbidden_road_types);
+    if (!std::isfinite(bound))
+        return {};
+    // ws.backward keeps the lower bounds. Nodes it did not settle are further
+    // than bound from the target; tentative distances are not bounds at all
+    bound_search(graph, ws, ws.backward, target, -1, true, false, bound, forbidden_road_types);
+    const SearchWorkspace::Side& lower = ws.backward;
+    auto lb = [&](int v) {
+        return lower.settled(v) ? lower.distance(v) : std::numeric_limits<double>::infinity();
+    };
+    // Candidates that only tie the bound may be the answer itself
+    auto beaten = [&](double reach) { return reach > bound + 1e-9 * std::max(1.0, bound); };
+
+    struct Label {
+        Profile f;
+        bool queued = false;
+    };
+    std::unordered_map<int, Label> labels;
+    SearchWorkspace::Side& queue = ws.forward;
+    queue.reset(n);
+
+    Label start;
+    start.f.fill(0.0);
+    start.queued = true;
+    labels[source] = start;
+    queue.push(lb(source), source);
+
+    while (!queue.empty()) {
+        auto [key, u] = queue.pop();
+        if (beaten(key)) break;
+        Label& lu = labels[u];
+        if (!lu.queued) continue;
+        lu.queued = false;
+        // Node-based storage keeps the reference valid while labels grows
+        const Profile& fu = lu.f;
+
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            if (!std::isfinite(graph.arcTime[a]) || ws.blocked(v)) continue;
+            if (!graph.arcAllowed(a, forbidden_road_types)) continue;
+
+            Profile fv = profile_link(graph, fu, a);
+            double fastest = *std::min_element(fv.begin(), fv.end());
+            if (beaten(fastest + lb(v))) continue;
+
+            auto it = labels.find(v);
+            if (it == labels.end())
+                it = labels.emplace(v, Label{fv, false}).first;
+            else if (!profile_merge(it->second.f, fv))
+                continue;
+
+            const Profile& f = it->second.f;
+            if (v == target) {
+                bound = std::min(bound, *std::max_element(f.begin(), f.end()));
+                continue;
+            }
+            it->second.queued = true;
+            queue.push(*std::min_element(f.begin(), f.end()) + lb(v), v);
+        }
+    }
+
+    auto t = labels.find(target);
+    if (t == labels.end())
+        return {};
+    return {true, t->second.f};
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Graph.hpp"
+
+// Binary graph snapshot, written once from graph.json and mapped read-only at
+// startup. All values are little-endian; the file is a header followed by
+// fixed-order sections, each padded to 8 bytes:
+//
+//   nodes      id i32[n], lat f64[n], lon f64[n]
+//   pois       poiOffsets u32[n+1], poiTags u32[poiRefs]        (tag table ids)
+//   strings    roadTypeOffsets u32[roadTypes+1], roadTypeChars   (interned road types)
+//              tagOffsets u32[tags+1], tagChars                  (interned POI tags)
+//   edges      id i32[m], u i32[m], v i32[m] (node ids), length f64[m], time f64[m],
+//              roadType u32[m], flags u8[m] (1 oneway, 2 removed),
+//              profileOffsets u32[m+1], profileValues f64[profileValues]  (empty: average_time)
+//   adjacency  offsets i32[n+1], arcTarget i32[arcs], arcEdge i32[arcs] (edge index),
+//              revOffsets i32[n+1], revSource i32[arcs], revArc i32[arcs]
+constexpr char SNAPSHOT_MAGIC[4] = {'G' , 'M' , 'S' , 'N'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;// reads back differently on a big-endian host
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t reserved;
+    uint64_t nodes, edges, arcs;
+    uint64_t roadTypes, roadTypeChars, tags, tagChars, poiRefs, profileValues;
+};
+
+enum : uint8_t { SNAPSHOT_ONEWAY = 1 , SNAPSHOT_REMOVED = 2 };
+
+inline bool save_snapshot(const std::string& path, const Graph& graph) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    uint64_t written = 0;
+    auto put = [&](const void* data, size_t len) {
+        out.write(static_cast<const char*>(data), len);
+        written += len;
+    };
+    auto section = [&](const auto& v) {
+        put(v.data(), v.size() * sizeof(v[0]));
+        static const char zero[8] = {};
+        put(zero, (8 - written % 8) % 8);
+    };
+
+    // String tables are the graph's own interned ones
+    const std::vector<std::string>& roadTypes = graph.roadTypes;
+    const std::vector<std::string>& tags = graph.poiTags;
+    auto flatten = [](const std::vector<std::string>& table, std::vector<uint32_t>& offs, std::string& chars) {
+        offs.assign(1, 0);
+        for (const std::string& s : table) {
+            chars += s;
+            offs.push_back((uint32_t)chars.size());
+        }
+    };
+
+    const int n = graph.numNodes();
+    std::vector<int32_t> nodeId(n);
+    std::vector<double> lat(n), lon(n);
+    std::vector<uint32_t> poiOffsets(1, 0), poiTags;
+    for (int i = 0; i < n; i++) {
+        const Node& node = graph.nodes[i];
+        nodeId[i] = node.id;
+        lat[i] = node.lat;
+        lon[i] = node.lon;
+        for (int t : node.pois)
+            poiTags.push_back((uint32_t)t);
+        poiOffsets.push_back((uint32_t)poiTags.size());
+    }
+
+    const size_t m = graph.edges.size();
+    std::vector<int32_t> edgeId, edgeU, edgeV;
+    std::vector<double> length, time, profileValues;
+    std::vector<uint32_t> roadType, profileOffsets(1, 0);
+    std::vector<uint8_t> flags;
+    for (size_t i = 0; i < m; i++) {
+        const Edge& e = graph.edges[i];
+        int id = e.id;
+        edgeId.push_back(id);
+        edgeU.push_back(e.u);
+        edgeV.push_back(e.v);
+        length.push_back(e.length);
+        time.push_back(e.average_time);
+        roadType.push_back(e.roadType);
+        flags.push_back((e.oneway ? SNAPSHOT_ONEWAY : 0) | (e.removed ? SNAPSHOT_REMOVED : 0));
+        const double* speed = graph.speeds(e.profile);
+        profileValues.insert(profileValues.end(), speed, speed + e.profile.count);
+        profileOffsets.push_back((uint32_t)profileValues.size());
+    }
+
+    std::vector<uint32_t> roadTypeOffsets, tagOffsets;
+    std::string roadTypeChars, tagChars;
+    flatten(roadTypes, roadTypeOffsets, roadTypeChars);
+    flatten(tags, tagOffsets, tagChars);
+
+    SnapshotHeader h{};
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, 4);
+    h.version = SNAPSHOT_VERSION;
+    h.byteOrder = SNAPSHOT_BYTE_ORDER;
+    h.nodes = n;
+    h.edges = m;
+    h.arcs = graph.arcTarget.size();
+    h.roadTypes = roadTypes.size();
+    h.roadTypeChars = roadTypeChars.size();
+    h.tags = tags.size();
+    h.tagChars = tagChars.size();
+    h.poiRefs = poiTags.size();
+    h.profileValues = profileValues.size();
+    put(&h, sizeof(h));
+
+    section(nodeId); section(lat); section(lon);
+    section(poiOffsets); section(poiTags);
+    section(roadTypeOffsets); section(roadTypeChars);
+    section(tagOffsets); section(tagChars);
+    section(edgeId); section(edgeU); section(edgeV); section(length); section(time);
+    section(roadType); section(flags); section(profileOffsets); section(profileValues);
+    section(graph.offsets); section(graph.arcTarget); section(graph.arcEdge);
+    section(graph.revOffsets); section(graph.revSource); section(graph.revArc);
+    return (bool)out;
+}
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<const char*>(p);
+                len = st.st_size;
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (base) ::munmap(const_cast<char*>(base), len);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return base; }
+    size_t size() const { return len; }
+
+private:
+    const char* base = nullptr;
+    size_t len = 0;
+};
+
+// Walks the sections of a mapped snapshot in file order; ok turns false once a
+// section would run past the end of the file
+struct SnapshotReader {
+    const char* base;
+    size_t size;
+    size_t pos;
+    bool ok = true;
+
+    template <typename T>
+    const T* take(uint64_t count) {
+        if (!ok || count > (size - pos) / sizeof(T)) {
+            ok = false;
+            return nullptr;
+        }
+        const T* p = reinterpret_cast<const T*>(base + pos);
+        pos += count * sizeof(T);
+        pos = std::min(size, pos + (8 - pos % 8) % 8);
+        return p;
+    }
+};
+
+// Whether a snapshot's adjacency is the one buildCSR would give the loaded
+// edges, up to arc order: each arc runs u -> v or v -> u of its edge, a live
+// edge has one forward arc and a reverse one unless oneway, an edge with a
+// missing end has none, and the reverse CSR lists every forward arc once
+// under its head. indexArcs relies on all of it
+inline bool snapshot_arcs_match(const Graph& graph, const int32_t* offsets, const int32_t* arcTarget,
+                                const int32_t* arcEdge, const int32_t* revOffsets,
+                                const int32_t* revSource, const int32_t* revArc) {
+    const int n = graph.numNodes();
+    const size_t m = graph.edges.size();
+    std::vector<std::pair<int, int>> count(m, {0, 0});// (forward , reverse) arcs per edge
+    for (int t = 0; t < n; t++) {
+        for (int a = offsets[t]; a < offsets[t + 1]; a++) {
+            const Edge& e = graph.edges[arcEdge[a]];
+            std::pair<int, int>& c = count[arcEdge[a]];
+            int tail = graph.nodes[t].id, head = graph.nodes[arcTarget[a]].id;
+            if (tail == e.u && head == e.v && c.first == 0) c.first++;
+            else if (tail == e.v && head == e.u) c.second++;
+            else return false;
+        }
+    }
+    for (size_t i = 0; i < m; i++) {
+        const Edge& e = graph.edges[i];
+        std::pair<int, int> c = count[i];
+        if (c.second > 1) return false;
+        if (e.removed) continue;// keeps whatever slots it had when removed
+        bool ends = graph.index(e.u) >= 0 && graph.index(e.v) >= 0;
+        std::pair<int, int> expected = ends ? std::make_pair(1, e.oneway ? 0 : 1) : std::make_pair(0, 0);
+        if (c != expected) return false;
+    }
+
+    const int arcs = offsets[n];
+    std::vector<char> seen(arcs, 0);
+    for (int h = 0; h < n; h++) {
+        for (int k = revOffsets[h]; k < revOffsets[h + 1]; k++) {
+            int a = revArc[k], s = revSource[k];
+            if (seen[a] || arcTarget[a] != h || a < offsets[s] || a >= offsets[s + 1]) return false;
+            seen[a] = 1;
+        }
+    }
+    return true;
+}
+
+// Fills an empty graph from a snapshot. Arrays are copied out of the mapping in
+// bulk, since the graph patches its own storage on updates; only per-arc weights
+// and travel-time functions are derived. False if the file is missing, from
+// another format version, or inconsistent, down to arcs that disagree with
+// their edges
+inline bool load_snapshot(const std::string& path, Graph& graph) {
+    MappedFile file(path);
+    if (!file.data() || file.size() < sizeof(SnapshotHeader)) return false;
+
+    SnapshotHeader h;
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (std::memcmp(h.magic, SNAPSHOT_MAGIC, 4) != 0 || h.version != SNAPSHOT_VERSION ||
+        h.byteOrder != SNAPSHOT_BYTE_ORDER)
+        return false;
+
+    SnapshotReader in{file.data(), file.size(), sizeof(h)};
+    const uint64_t n = h.nodes, m = h.edges, arcs = h.arcs;
+    auto nodeId = in.take<int32_t>(n);
+    auto lat = in.take<double>(n);
+    auto lon = in.take<double>(n);
+    auto poiOffsets = in.take<uint32_t>(n + 1);
+    auto poiTags = in.take<uint32_t>(h.poiRefs);
+    auto roadTypeOffsets = in.take<uint32_t>(h.roadTypes + 1);
+    auto roadTypeChars = in.take<char>(h.roadTypeChars);
+    auto tagOffsets = in.take<uint32_t>(h.tags + 1);
+    auto tagChars = in.take<char>(h.tagChars);
+    auto edgeId = in.take<int32_t>(m);
+    auto edgeU = in.take<int32_t>(m);
+    auto edgeV = in.take<int32_t>(m);
+    auto length = in.take<double>(m);
+    auto time = in.take<double>(m);
+    auto roadType = in.take<uint32_t>(m);
+    auto flags = in.take<uint8_t>(m);
+    auto profileOffsets = in.take<uint32_t>(m + 1);
+    auto profileValues = in.take<double>(h.profileValues);
+    auto offsets = in.take<int32_t>(n + 1);
+    auto arcTarget = in.take<int32_t>(arcs);
+    auto arcEdge = in.take<int32_t>(arcs);
+    auto revOffsets = in.take<int32_t>(n + 1);
+    auto revSource = in.take<int32_t>(arcs);
+    auto revArc = in.take<int32_t>(arcs);
+    if (!in.ok) return false;
+
+    // Every offset table must be monotone and end at its section size, and every
+    // index must land inside its target section
+    auto monotone = [](const auto* offs, uint64_t count, uint64_t end) {
+        if (offs[0] != 0 || (uint64_t)offs[count] != end) return false;
+        for (uint64_t i = 0; i < count; i++)
+            if (offs[i] > offs[i + 1]) return false;
+        return true;
+    };
+    auto below = [](const auto* v, uint64_t count, uint64_t limit) {
+        for (uint64_t i = 0; i < count; i++)
+            if ((uint64_t)(int64_t)v[i] >= limit) return false;// negatives wrap past any limit
+        return true;
+    };
+    if (!monotone(poiOffsets, n, h.poiRefs) || !monotone(roadTypeOffsets, h.roadTypes, h.roadTypeChars) ||
+        !monotone(tagOffsets, h.tags, h.tagChars) || !monotone(profileOffsets, m, h.profileValues) ||
+        !monotone(offsets, n, arcs) || !monotone(revOffsets, n, arcs) ||
+        !below(poiTags, h.poiRefs, h.tags) || !below(roadType, m, h.roadTypes) ||
+        !below(arcTarget, arcs, n) || !below(arcEdge, arcs, m) ||
+        !below(revSource, arcs, n) || !below(revArc, arcs, arcs))
+        return false;
+
+    auto str = [](const uint32_t* offs, const char* chars, uint32_t i) {
+        return std::string(chars + offs[i], chars + offs[i + 1]);
+    };
+    graph = Graph();
+    std::vector<int> tags(h.tags);// file table id -> graph id
+    for (uint32_t i = 0; i < h.tags; i++) tags[i] = graph.internPoiTag(str(tagOffsets, tagChars, i));
+    std::vector<uint8_t> roadTypes(h.roadTypes);// file table id -> graph id
+    for (uint32_t i = 0; i < h.roadTypes; i++) {
+        int type = graph.internRoadType(str(roadTypeOffsets, roadTypeChars, i));
+        if (type < 0) return false;
+        roadTypes[i] = (uint8_t)type;
+    }
+    graph.nodes.write().reserve(n);
+    for (uint64_t i = 0; i < n; i++) {
+        std::vector<int> pois;
+        for (uint32_t k = poiOffsets[i]; k < poiOffsets[i + 1]; k++)
+            pois.push_back(tags[poiTags[k]]);
+        graph.addNode(Node(nodeId[i], lat[i], lon[i], pois));
+    }
+    if ((uint64_t)graph.numNodes() != n) return false;// duplicate node ids
+
+    graph.edgeIndex.write().reserve(m);
+    ProfileIndex profiles;
+    for (uint64_t i = 0; i < m; i++) {
+        std::vector<double> profile(profileValues + profileOffsets[i], profileValues + profileOffsets[i + 1]);
+        if (!Graph::validProfile(profile.size())) return false;
+        Edge e(edgeId[i], edgeU[i], edgeV[i], length[i], time[i],
+               flags[i] & SNAPSHOT_ONEWAY, roadTypes[roadType[i]], graph.internProfile(profile, profiles));
+        e.removed = flags[i] & SNAPSHOT_REMOVED;
+        graph.putEdge(e);
+    }
+    if (graph.edges.size() != m) return false;// duplicate edge ids
+    if (!snapshot_arcs_match(graph, offsets, arcTarget, arcEdge, revOffsets, revSource, revArc)) return false;
+
+    graph.offsets.write().assign(offsets, offsets + n + 1);
+    graph.arcTarget.write().assign(arcTarget, arcTarget + arcs);
+    graph.arcEdge.write().assign(arcEdge, arcEdge + arcs);
+    graph.revOffsets.write().assign(revOffsets, revOffsets + n + 1);
+    graph.revSource.write().assign(revSource, revSource + arcs);
+    graph.revArc.write().assign(revArc, revArc + arcs);
+    graph.indexArcs();
+    return true;
+}
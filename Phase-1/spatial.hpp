@@ -0,0 +1,237 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <queue>
+#include <utility>
+#include <algorithm>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+
+// Static k-d tree over the lon/lat of a set of nodes. It is bulk-loaded once:
+// the points are reordered in place so every range [lo, hi) has its median
+// split at (lo + hi) / 2, alternating lon and lat by depth. No pointers are
+// stored.
+//
+// A query answers exactly what a linear scan (knn_euclidean, knn_geodesic)
+// would: the k nodes smallest by (distance, dense index), ties included, but
+// only opens the subtrees whose splitting plane is no farther than the
+// current k-th best.
+class NodeKdTree {
+public:
+    NodeKdTree() {}
+
+    NodeKdTree(const Graph& graph, const std::vector<int>& nodes) {
+        pts.reserve(nodes.size());
+        for (int v : nodes)
+            pts.push_back({{graph.nodes[v].lon, graph.nodes[v].lat}, v});
+        build(0, (int)pts.size(), 0);
+    }
+
+    size_t size() const { return pts.size(); }
+
+    // Dense indices of the k nearest nodes in plain degrees, nearest first
+    std::vector<int> nearest(double query_lat, double query_lon, int k) const {
+        if (k <= 0)
+            return {};
+        Search s{{query_lon, query_lat}, k, {}};
+        search(s, 0, (int)pts.size(), 0);
+
+        std::vector<int> result;
+        while (!s.best.empty()) {
+            result.push_back(s.best.top().second);
+            s.best.pop();
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    // (meters, dense index) of the k nodes nearest along the earth's surface,
+    // nearest first. Splitting planes prune by a lower bound on the
+    // great-circle distance to anything beyond them; only points in the
+    // leaves opened get the full haversine distance
+    std::vector<std::pair<double, int>> nearestGeodesic(double query_lat, double query_lon, int k) const {
+        return nearestGeodesic(query_lat, query_lon, k, [](int) { return true; });
+    }
+
+    // The same, over only the nodes keep(v) accepts. Rejected points are
+    // never offered, so the pruning bounds still hold
+    template <class Keep>
+    std::vector<std::pair<double, int>> nearestGeodesic(double query_lat, double query_lon, int k, const Keep& keep) const {
+        if (k <= 0)
+            return {};
+        Search s{{query_lon, query_lat}, k, {}};
+        s.cosLat = std::cos(deg_to_rad(query_lat));
+        searchGeodesic(s, 0, (int)pts.size(), 0, keep);
+
+        std::vector<std::pair<double, int>> result;
+        while (!s.best.empty()) {
+            result.push_back(s.best.top());
+            s.best.pop();
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    // Ranges this small are scanned rather than split further
+    static constexpr int LEAF = 8;
+
+    // Lower bounds are shrunk by this much so rounding can never let one pass
+    // the haversine distance it stands for
+    static constexpr double BOUND_SLACK = 1.0 - 1e-9;
+
+    struct Point {
+        double c[2];// lon, lat
+        int node;
+    };
+
+    struct Search {
+        double q[2];
+        int k;
+        std::priority_queue<std::pair<double, int>> best;// worst of the k on top
+        double cosLat = 1.0;// geodesic searches only
+    };
+
+    std::vector<Point> pts;
+
+    void build(int lo, int hi, int axis) {
+        if (hi - lo <= LEAF) return;
+        int mid = (lo + hi) / 2;
+        std::nth_element(pts.begin() + lo, pts.begin() + mid, pts.begin() + hi,
+                         [axis](const Point& a, const Point& b) { return a.c[axis] < b.c[axis]; });
+        build(lo, mid, axis ^ 1);
+        build(mid + 1, hi, axis ^ 1);
+    }
+
+    static void offer(Search& s, std::pair<double, int> item) {
+        if ((int)s.best.size() == s.k && !(item < s.best.top())) return;
+        s.best.push(item);
+        if ((int)s.best.size() > s.k)
+            s.best.pop();
+    }
+
+    // Same arithmetic as knn_euclidean, so equal distances stay equal
+    static void offerEuclidean(Search& s, const Point& p) {
+        double dx = p.c[0] - s.q[0];
+        double dy = p.c[1] - s.q[1];
+        offer(s, {std::sqrt(dx * dx + dy * dy), p.node});
+    }
+
+    void search(Search& s, int lo, int hi, int axis) const {
+        if (hi - lo <= LEAF) {
+            for (int i = lo; i < hi; i++)
+                offerEuclidean(s, pts[i]);
+            return;
+        }
+        int mid = (lo + hi) / 2;
+        double diff = s.q[axis] - pts[mid].c[axis];
+        bool left = diff < 0;
+        search(s, left ? lo : mid + 1, left ? mid : hi, axis ^ 1);
+        offerEuclidean(s, pts[mid]);
+
+        // Points across the plane are at least |diff| away; rounding is
+        // monotone, so this never exceeds their computed distance. A bound
+        // equal to the k-th best is still opened for its index ties
+        if ((int)s.best.size() == s.k && std::sqrt(diff * diff) > s.best.top().first) return;
+        search(s, left ? mid + 1 : lo, left ? hi : mid, axis ^ 1);
+    }
+
+    static void offerGeodesic(Search& s, const Point& p) {
+        // Latitude alone gives a cheap bound before the full formula
+        if ((int)s.best.size() == s.k &&
+            EARTH_RADIUS * std::fabs(deg_to_rad(p.c[1] - s.q[1])) * BOUND_SLACK > s.best.top().first)
+            return;
+        offer(s, {haversine_distance(s.q[1], s.q[0], p.c[1], p.c[0]), p.node});
+    }
+
+    // Great-circle distance from the query to the nearest point that could lie
+    // across the plane c[axis] = split, on the side away from the query
+    static double planeBound(const Search& s, int axis, double split) {
+        if (axis == 1)
+            return EARTH_RADIUS * std::fabs(deg_to_rad(s.q[1] - split)) * BOUND_SLACK;
+        // The far side also starts where longitudes wrap at +-180, so take the
+        // shorter way round; past 90 degrees the meridian bound stops growing
+        double gap = s.q[0] >= split ? std::min(s.q[0] - split, 180.0 - s.q[0])
+                                     : std::min(split - s.q[0], s.q[0] + 180.0);
+        gap = deg_to_rad(std::min(std::max(gap, 0.0), 90.0));
+        return EARTH_RADIUS * std::asin(std::min(1.0, s.cosLat * std::sin(gap))) * BOUND_SLACK;
+    }
+
+    template <class Keep>
+    void searchGeodesic(Search& s, int lo, int hi, int axis, const Keep& keep) const {
+        if (hi - lo <= LEAF) {
+            for (int i = lo; i < hi; i++)
+                if (keep(pts[i].node)) offerGeodesic(s, pts[i]);
+            return;
+        }
+        int mid = (lo + hi) / 2;
+        double split = pts[mid].c[axis];
+        bool left = s.q[axis] < split;
+        searchGeodesic(s, left ? lo : mid + 1, left ? mid : hi, axis ^ 1, keep);
+        if (keep(pts[mid].node)) offerGeodesic(s, pts[mid]);
+        if ((int)s.best.size() == s.k && planeBound(s, axis, split) > s.best.top().first) return;
+        searchGeodesic(s, left ? mid + 1 : lo, left ? hi : mid, axis ^ 1, keep);
+    }
+};
+
+// One tree per POI tag, for Euclidean and geodesic kNN
+class PoiSpatialIndex {
+public:
+    explicit PoiSpatialIndex(const Graph& graph) : n(graph.numNodes()) {
+        const std::vector<std::vector<int>>& lists = graph.poiNodes;
+        trees.reserve(lists.size());
+        for (const std::vector<int>& list : lists)
+            trees.emplace_back(graph, list);
+    }
+
+    // Node coordinates and POI tags only change while the graph is loaded
+    bool current(const Graph& graph) const {
+        return n == graph.numNodes() && trees.size() == graph.poiTags.size();
+    }
+
+    // Dense indices of the k nearest nodes carrying tag, nearest first
+    std::vector<int> nearest(double query_lat, double query_lon, int tag, int k) const {
+        if (tag < 0 || tag >= (int)trees.size())
+            return {};
+        return trees[tag].nearest(query_lat, query_lon, k);
+    }
+
+    // (meters, dense index) of the k nearest nodes carrying tag, nearest first
+    std::vector<std::pair<double, int>> nearestGeodesic(double query_lat, double query_lon, int tag, int k) const {
+        if (tag < 0 || tag >= (int)trees.size())
+            return {};
+        return trees[tag].nearestGeodesic(query_lat, query_lon, k);
+    }
+
+private:
+    int n;
+    std::vector<NodeKdTree> trees;// POI tag id -> tree
+};
+
+// Snaps coordinates to the nearest routable node by great-circle distance.
+// The tree holds every node and asks the graph version being queried which
+// ones are routable, so removals and direction changes never make it stale
+class SnapIndex {
+public:
+    explicit SnapIndex(const Graph& graph) : n(graph.numNodes()) {
+        std::vector<int> nodes(n);
+        for (int v = 0; v < n; v++)
+            nodes[v] = v;
+        tree = NodeKdTree(graph, nodes);
+    }
+
+    // Nodes are only added while the graph is loaded
+    bool current(const Graph& graph) const { return n == graph.numNodes(); }
+
+    // Dense index of the nearest node routable in graph, -1 if it has none
+    int snap(const Graph& graph, double lat, double lon) const {
+        std::vector<std::pair<double, int>> nearest =
+            tree.nearestGeodesic(lat, lon, 1, [&graph](int v) { return graph.routable(v); });
+        return nearest.empty() ? -1 : nearest[0].second;
+    }
+
+private:
+    int n;
+    NodeKdTree tree;
+};
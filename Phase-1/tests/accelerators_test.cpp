@@ -0,0 +1,255 @@
+// Checks every shortest_path and kNN accelerator against a plain Dijkstra over
+// the edge list, on a small graph and again after modify_edge / remove_edge
+// updates. Built by `make test`, exits non-zero on a failure.
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+#include "ch.hpp"
+#include "crp.hpp"
+#include "alt.hpp"
+#include "buckets.hpp"
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+static bool close(double a, double b) {
+    if (std::isinf(a) || std::isinf(b)) return a == b;
+    return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(a));
+}
+
+const int SIDE = 6;
+const char* TAGS[] = {"Restaurant", "Hospital"};
+
+// SIDE x SIDE grid about 110 m apart with a few diagonals and oneway streets.
+// Lengths stay above the great-circle distance, so haversine is a lower bound
+static Graph sample() {
+    Graph graph;
+    for (const char* tag : TAGS) graph.internPoiTag(tag);
+    int primary = graph.internRoadType("primary"), residential = graph.internRoadType("residential");
+    for (int r = 0; r < SIDE; r++) {
+        for (int c = 0; c < SIDE; c++) {
+            int id = 100 + r * SIDE + c;// ids differ from dense indices
+            std::vector<int> pois;
+            if (id % 4 == 1) pois.push_back(0);
+            if (id % 9 == 2) pois.push_back(1);
+            graph.addNode(Node(id, r * 0.001, c * 0.001, pois));
+        }
+    }
+    ProfileIndex profiles;
+    int next = 0;
+    auto link = [&](int a, int b) {
+        int id = next++;
+        const Node& x = graph.nodes[graph.index(a)];
+        const Node& y = graph.nodes[graph.index(b)];
+        double meters = haversine_distance(x, y);
+        Edge e(id, a, b, meters * (1.05 + (id * 7 % 5) * 0.3), meters / (5.0 + id * 3 % 11),
+               id % 6 == 2, (uint8_t)(id % 3 ? primary : residential), graph.internProfile({}, profiles));
+        graph.putEdge(e);
+    };
+    for (int r = 0; r < SIDE; r++) {
+        for (int c = 0; c < SIDE; c++) {
+            int id = 100 + r * SIDE + c;
+            if (c + 1 < SIDE) link(id, id + 1);
+            if (r + 1 < SIDE) link(id, id + SIDE);
+            if (r + 1 < SIDE && c + 1 < SIDE && (r + c) % 3 == 0) link(id, id + SIDE + 1);
+        }
+    }
+    graph.buildCSR();
+    return graph;
+}
+
+// Reference distances from source over the live edges, respecting the constraints
+static std::vector<double> dijkstra(const Graph& graph, int source, const std::string& mode,
+                                    const std::vector<int>& forbidden_nodes = {},
+                                    const RoadTypeMask& forbidden_road_types = RoadTypeMask()) {
+    const int n = graph.numNodes();
+    std::vector<std::vector<std::pair<int, double>>> out(n);
+    std::vector<char> blocked(n, 0);
+    for (int f : forbidden_nodes) blocked[f] = 1;
+    for (size_t i = 0; i < graph.edges.size(); i++) {
+        const Edge& e = graph.edges[i];
+        if (e.removed || forbidden_road_types.test(e.roadType)) continue;
+        int u = graph.index(e.u), v = graph.index(e.v);
+        double w = mode == "distance" ? e.length : e.average_time;
+        out[u].push_back({v, w});
+        if (!e.oneway) out[v].push_back({u, w});
+    }
+    std::vector<double> dist(n, std::numeric_limits<double>::infinity());
+    using Item = std::pair<double, int>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> pq;
+    if (blocked[source]) return dist;
+    dist[source] = 0.0;
+    pq.push({0.0, source});
+    while (!pq.empty()) {
+        auto [d, u] = pq.top();
+        pq.pop();
+        if (d > dist[u]) continue;
+        for (auto [v, w] : out[u]) {
+            if (blocked[v] || d + w >= dist[v]) continue;
+            dist[v] = d + w;
+            pq.push({dist[v], v});
+        }
+    }
+    return dist;
+}
+
+// Whether result is the reference answer: same reachability and cost, and a
+// path from source to target along allowed arcs that adds up to that cost
+static bool matches(const Graph& graph, const PathResult& result, int source, int target, double expected,
+                    const std::string& mode, const std::vector<int>& forbidden_nodes = {},
+                    const RoadTypeMask& forbidden_road_types = RoadTypeMask()) {
+    if (!std::isfinite(expected)) return !result.found;
+    if (!result.found || !close(result.cost, expected)) return false;
+    const std::vector<int>& path = result.path;
+    if (path.empty() || path.front() != source || path.back() != target) return false;
+    const ArcWeights& weight = mode == "distance" ? graph.arcLength : graph.arcTime;
+    double cost = 0.0;
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        if (std::find(forbidden_nodes.begin(), forbidden_nodes.end(), path[i + 1]) != forbidden_nodes.end())
+            return false;
+        double step = std::numeric_limits<double>::infinity();
+        for (int a = graph.offsets[path[i]]; a < graph.offsets[path[i] + 1]; a++) {
+            if (graph.arcTarget[a] == path[i + 1] && graph.arcAllowed(a, forbidden_road_types))
+                step = std::min(step, weight[a]);
+        }
+        cost += step;
+    }
+    return close(cost, expected);
+}
+
+// Whether nodes are k POIs with tag at the k smallest reference distances
+static bool nearest_pois(const Graph& graph, const std::vector<int>& nodes, int source, int tag, int k) {
+    std::vector<double> dist = dijkstra(graph, source, "distance");
+    std::vector<double> expected, got;
+    for (int v : graph.poiNodes[tag]) {
+        if (std::isfinite(dist[v])) expected.push_back(dist[v]);
+    }
+    std::sort(expected.begin(), expected.end());
+    if ((int)expected.size() > k) expected.resize(k);
+    for (int v : nodes) {
+        if (!graph.hasPoi(v, tag) || std::count(nodes.begin(), nodes.end(), v) != 1) return false;
+        got.push_back(dist[v]);
+    }
+    if (got.size() != expected.size()) return false;
+    for (size_t i = 0; i < got.size(); i++) {
+        if (!close(got[i], expected[i])) return false;
+    }
+    return true;
+}
+
+// Graph searches, with and without landmarks and constraints, and the overlay
+static void check_searches(const Graph& graph, const CRPOverlay& crp, const Landmarks& landmarks, const char* stage) {
+    SearchWorkspace ws;
+    const int n = graph.numNodes();
+    bool astar = true, bidirectional = true, alt = true, overlay = crp.current(), constrained = true;
+    std::vector<int> forbidden_nodes = {n / 2, n / 2 + 1};
+    RoadTypeMask forbidden_road_types;
+    forbidden_road_types.set(graph.roadTypeId("residential"));
+    for (const std::string mode : {"distance", "time"}) {
+        for (int s = 0; s < n; s++) {
+            std::vector<double> dist = dijkstra(graph, s, mode);
+            std::vector<double> cdist = dijkstra(graph, s, mode, forbidden_nodes, forbidden_road_types);
+            for (int t = 0; t < n; t++) {
+                astar = astar && matches(graph, shortest_path(graph, ws, s, t, mode, {}, {}), s, t, dist[t], mode);
+                bidirectional = bidirectional &&
+                    matches(graph, bidirectional_shortest_path(graph, ws, s, t, mode, {}, {}), s, t, dist[t], mode);
+                alt = alt &&
+                    matches(graph, shortest_path(graph, ws, s, t, mode, {}, {}, &landmarks), s, t, dist[t], mode) &&
+                    matches(graph, bidirectional_shortest_path(graph, ws, s, t, mode, {}, {}, &landmarks), s, t, dist[t], mode);
+                overlay = overlay && matches(graph, crp.query(ws, s, t, mode), s, t, dist[t], mode);
+
+                if (std::count(forbidden_nodes.begin(), forbidden_nodes.end(), t)) continue;
+                double expected = cdist[t];
+                constrained = constrained &&
+                    matches(graph, shortest_path(graph, ws, s, t, mode, forbidden_nodes, forbidden_road_types, &landmarks),
+                            s, t, expected, mode, forbidden_nodes, forbidden_road_types) &&
+                    matches(graph, bidirectional_shortest_path(graph, ws, s, t, mode, forbidden_nodes, forbidden_road_types, &landmarks),
+                            s, t, expected, mode, forbidden_nodes, forbidden_road_types);
+            }
+        }
+    }
+    std::string at = std::string(" (") + stage + ")";
+    expect(astar, ("A* matches Dijkstra" + at).c_str());
+    expect(bidirectional, ("bidirectional search matches Dijkstra" + at).c_str());
+    expect(alt, ("ALT searches match Dijkstra" + at).c_str());
+    expect(overlay, ("CRP overlay is current and matches Dijkstra" + at).c_str());
+    expect(constrained, ("constrained searches match Dijkstra" + at).c_str());
+
+    bool knn = true;
+    for (int tag = 0; tag < (int)graph.poiTags.size(); tag++) {
+        for (int s = 0; s < n; s++)
+            knn = knn && nearest_pois(graph, knn_shortest_path(graph, ws, s, tag, 3), s, tag, 3);
+    }
+    expect(knn, ("Dijkstra kNN matches the reference" + at).c_str());
+}
+
+// Hierarchies and the buckets built on them, which only describe the weights
+// they were built from
+static void check_hierarchies(const Graph& graph, const char* stage) {
+    SearchWorkspace ws;
+    const int n = graph.numNodes();
+    bool ch = true, buckets = true;
+    ContractionHierarchy distance = ContractionHierarchy::build(graph, graph.arcLength);
+    ContractionHierarchy time = ContractionHierarchy::build(graph, graph.arcTime);
+    for (int s = 0; s < n; s++) {
+        std::vector<double> dist = dijkstra(graph, s, "distance");
+        std::vector<double> tdist = dijkstra(graph, s, "time");
+        for (int t = 0; t < n; t++) {
+            ch = ch && matches(graph, distance.query(ws, s, t), s, t, dist[t], "distance") &&
+                 matches(graph, time.query(ws, s, t), s, t, tdist[t], "time");
+        }
+    }
+    PoiBuckets pois(graph, distance);
+    for (int tag = 0; tag < (int)graph.poiTags.size(); tag++) {
+        buckets = buckets && pois.current(graph) && pois.covers(tag);
+        for (int s = 0; s < n; s++) {
+            for (int k : {1, 3, 50})
+                buckets = buckets && nearest_pois(graph, pois.nearest(ws, s, tag, k), s, tag, k);
+        }
+    }
+    std::string at = std::string(" (") + stage + ")";
+    expect(ch, ("CH matches Dijkstra" + at).c_str());
+    expect(buckets, ("bucket kNN matches the reference" + at).c_str());
+}
+
+int main() {
+    Graph graph = sample();
+    CRPOverlay crp(graph, 4, 2);
+    Landmarks landmarks(graph, 4);
+    check_searches(graph, crp, landmarks, "as built");
+    check_hierarchies(graph, "as built");
+
+    // A hierarchy built before the updates must say it no longer applies
+    ContractionHierarchy stale = ContractionHierarchy::build(graph, graph.arcLength);
+
+    // Weight patches both ways (slower and faster, which turns landmarks off),
+    // removals, and a direction change that rebuilds the arc set
+    graph.modifyEdge(3, {{"length", 2000.0}});
+    graph.modifyEdge(8, {{"average_time", 0.5}});
+    graph.modifyEdge(14, {{"length", 900.0}, {"average_time", 300.0}});
+    graph.removeEdge(5);
+    graph.removeEdge(21);
+    check_searches(graph, crp, landmarks, "after weight patches and removals");
+    expect(!stale.current(graph), "hierarchy goes stale after updates");
+
+    graph.modifyEdge(2, {{"oneway", false}});
+    graph.modifyEdge(17, {{"oneway", true}});
+    graph.removeEdge(30);
+    check_searches(graph, crp, landmarks, "after direction changes");
+    check_hierarchies(graph, "rebuilt after updates");
+
+    if (failures == 0)
+        std::cout << "accelerators_test: all checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
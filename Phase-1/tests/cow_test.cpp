@@ -0,0 +1,147 @@
+// Checks that a pinned graph version keeps answering from its own data while
+// the live graph is patched. Built by `make test`, exits non-zero on a failure.
+
+#include <iostream>
+#include <vector>
+#include "Graph.hpp"
+#include "timedep.hpp"
+#include "loader.hpp"
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// Path 0 - 1 - 2 with full speed profiles, plus a flat edge 2 - 3
+static Graph sample() {
+    Graph graph;
+    for (int id = 0; id < 4; id++)
+        graph.addNode(Node(id, 0.0, id * 0.01, {}));
+    int primary = graph.internRoadType("primary");
+    ProfileIndex profiles;
+    std::vector<double> speed(SPEED_PROFILE_VALUES);
+    for (int j = 0; j < SPEED_PROFILE_VALUES; j++)
+        speed[j] = 10.0 + j % 7;
+    graph.putEdge(Edge(0, 0, 1, 1000.0, 100.0, false, (uint8_t)primary, graph.internProfile(speed, profiles)));
+    graph.putEdge(Edge(1, 1, 2, 2000.0, 200.0, false, (uint8_t)primary, graph.internProfile(speed, profiles)));
+    graph.putEdge(Edge(2, 2, 3, 500.0, 50.0, false, (uint8_t)primary, graph.internProfile({10.0}, profiles)));
+    graph.buildCSR();
+    return graph;
+}
+
+// Travel time of an edge's forward arc at every bucket start
+static std::vector<double> travel_times(const Graph& graph, int id) {
+    std::vector<double> times;
+    int arc = graph.edgeArcs[graph.edgeSlot(id)].first;
+    for (int j = 0; j < SPEED_PROFILE_VALUES; j++)
+        times.push_back(arc_travel_time(graph, arc, j * DAY_SECONDS / SPEED_PROFILE_VALUES));
+    return times;
+}
+
+static json speed_patch(double base) {
+    std::vector<double> speed(SPEED_PROFILE_VALUES);
+    for (int j = 0; j < SPEED_PROFILE_VALUES; j++)
+        speed[j] = base + j % 5;
+    return {{"speed_profile", speed}};
+}
+
+static void pinned_version_survives_speed_profile_patch() {
+    Graph graph = sample();
+    std::shared_ptr<const Graph> pinned = graph.snapshot();
+    std::vector<double> before = travel_times(*pinned, 0);
+    std::vector<double> speeds(pinned->speeds(pinned->edge(0)->profile),
+                               pinned->speeds(pinned->edge(0)->profile) + SPEED_PROFILE_VALUES);
+
+    graph.modifyEdge(0, speed_patch(40.0));
+
+    expect(travel_times(*pinned, 0) == before, "pinned travel times unchanged by speed_profile patch");
+    expect(std::equal(speeds.begin(), speeds.end(), pinned->speeds(pinned->edge(0)->profile)),
+           "pinned speeds unchanged by speed_profile patch");
+    expect(travel_times(graph, 0) != before, "live graph sees the speed_profile patch");
+    // Edge 1 shared edge 0's loaded profile and must not see the patch either
+    expect(travel_times(graph, 1) == travel_times(*pinned, 1), "patch stays on its own edge");
+}
+
+static void repeated_patches_reuse_their_runs() {
+    Graph graph = sample();
+    graph.modifyEdge(0, speed_patch(40.0));
+    graph.modifyEdge(2, speed_patch(20.0));// flat edge gets a full profile once
+    size_t values = graph.profileValues.size(), points = graph.ttfPoints.size();
+
+    for (int round = 0; round < 100; round++) {
+        std::shared_ptr<const Graph> pinned = graph.snapshot();
+        std::vector<double> before = travel_times(*pinned, 2);
+        graph.modifyEdge(2, speed_patch(21.0 + round));
+        graph.modifyEdge(0, speed_patch(41.0 + round));
+        expect(travel_times(*pinned, 2) == before, "pinned version unchanged across repeated patches");
+    }
+    expect(graph.profileValues.size() == values, "profile pool does not grow on repeated patches");
+    expect(graph.ttfPoints.size() == points, "travel-time points do not grow on repeated patches");
+}
+
+static void pinned_version_survives_weight_patch_and_removal() {
+    Graph graph = sample();
+    std::shared_ptr<const Graph> pinned = graph.snapshot();
+    int arc = pinned->edgeArcs[pinned->edgeSlot(1)].first;
+
+    graph.modifyEdge(1, {{"length", 9000.0}});
+    graph.removeEdge(0);
+
+    expect(pinned->arcLength[arc] == 2000.0, "pinned length unchanged by length patch");
+    expect(graph.arcLength[arc] == 9000.0, "live graph sees the length patch");
+    expect(!pinned->edge(0)->removed && graph.edge(0)->removed, "removal only seen by the live graph");
+}
+
+// An edge loaded without a speed_profile follows its average_time, before and after patches
+static void profileless_edge_follows_average_time() {
+    Graph graph;
+    GraphSaxLoader loader(graph);
+    json::sax_parse(R"({
+        "meta": {"id": "test", "nodes": 2, "description": "one edge without a speed_profile"},
+        "nodes": [{"id": 0, "lat": 0.0, "lon": 0.0, "pois": []},
+                  {"id": 1, "lat": 0.0, "lon": 0.01, "pois": []}],
+        "edges": [{"id": 0, "u": 0, "v": 1, "length": 1000.0, "average_time": 100.0,
+                   "oneway": false, "road_type": "primary"}]
+    })", &loader);
+    expect(loader.complete(), "graph with a profile-less edge loads");
+    if (!loader.complete()) return;
+    int arc = graph.edgeArcs[0].first;
+    expect(arc_travel_time(graph, arc, 3600.0) == 100.0, "profile-less edge takes its average_time");
+
+    graph.modifyEdge(0, {{"average_time", 500.0}});
+    expect(arc_travel_time(graph, arc, 3600.0) == 500.0, "average_time patch reaches the travel time");
+    expect(graph.arcTtf[arc].lo == 500.0 && graph.arcTtf[arc].hi == 500.0, "average_time patch reaches the bounds");
+
+    graph.modifyEdge(0, {{"length", 3000.0}});
+    expect(arc_travel_time(graph, arc, 3600.0) == 500.0, "length patch leaves the travel time alone");
+    expect(arc_travel_time(graph, arc, 3600.0) == graph.arcTime[arc], "time-dependent and static times agree");
+}
+
+// Items a grow adds take the new value, even where a shrink cut whole blocks off
+static void shrink_then_grow_refills() {
+    CowArray<int, 4> array;
+    array.assign(10, 7);
+    CowArray<int, 4> pinned = array;
+    array.resize(3);
+    array.resize(12, 1);
+    bool refilled = true;
+    for (size_t i = 3; i < array.size(); i++)
+        refilled = refilled && array[i] == 1;
+    expect(refilled && array[0] == 7 && array[2] == 7, "grow after shrink fills every new item");
+    expect(pinned.size() == 10 && pinned[9] == 7, "shrink leaves a sharing copy whole");
+}
+
+int main() {
+    pinned_version_survives_speed_profile_patch();
+    repeated_patches_reuse_their_runs();
+    pinned_version_survives_weight_patch_and_removal();
+    profileless_edge_follows_average_time();
+    shrink_then_grow_refills();
+    if (failures == 0)
+        std::cout << "cow_test: all checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
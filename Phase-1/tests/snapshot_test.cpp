@@ -0,0 +1,168 @@
+// Checks that a graph saved with save_snapshot loads back answering exactly as
+// the graph it was saved from, and that corrupt snapshots are refused instead of
+// loaded. Built by `make test`, exits non-zero on a failure.
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+#include "timedep.hpp"
+#include "loader.hpp"
+#include "snapshot.hpp"
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+static const std::string SNAPSHOT_PATH =
+    (std::filesystem::temp_directory_path() / "gmaps_snapshot_test.snap").string();
+
+// 4 x 4 grid roughly 110 m apart, every length a bit above the great-circle
+// distance so haversine stays a lower bound. A few edges are oneway, a few
+// carry full speed profiles, and nodes carry POI tags
+static Graph sample() {
+    const int side = 4;
+    json nodes = json::array(), edges = json::array();
+    const char* tags[] = {"Restaurant", "Hospital", "School"};
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            int id = 10 * r + c;
+            json pois = json::array();
+            if (id % 3 == 0) pois.push_back(tags[id % 2]);
+            if (id % 5 == 0) pois.push_back(tags[2]);
+            nodes.push_back({{"id", id}, {"lat", r * 0.001}, {"lon", c * 0.001}, {"pois", pois}});
+        }
+    }
+    int next = 0;
+    auto link = [&](int a, int b) {
+        int id = next++;
+        double meters = haversine_distance(a / 10 * 0.001, a % 10 * 0.001, b / 10 * 0.001, b % 10 * 0.001);
+        json e = {{"id", id}, {"u", a}, {"v", b}, {"length", meters * (1.1 + id % 4 * 0.2)},
+                  {"average_time", meters / (8.0 + id % 5)}, {"oneway", id % 7 == 3},
+                  {"road_type", id % 2 ? "primary" : "residential"}};
+        if (id % 3 == 1) {
+            std::vector<double> speed(SPEED_PROFILE_VALUES);
+            for (int j = 0; j < SPEED_PROFILE_VALUES; j++)
+                speed[j] = 6.0 + (j + id) % 9;
+            e["speed_profile"] = speed;
+        }
+        edges.push_back(e);
+    };
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            if (c + 1 < side) link(10 * r + c, 10 * r + c + 1);
+            if (r + 1 < side) link(10 * r + c, 10 * (r + 1) + c);
+        }
+    }
+    json doc = {{"meta", {{"id", "snapshot_test"}, {"nodes", side * side}, {"description", "grid"}}},
+                {"nodes", nodes}, {"edges", edges}};
+
+    Graph graph;
+    GraphSaxLoader loader(graph);
+    json::sax_parse(doc.dump(), &loader);
+    expect(loader.complete(), "sample graph loads from JSON");
+
+    // Updates before saving, so removed flags and patched profiles go through the file too
+    graph.removeEdge(4);
+    graph.modifyEdge(9, {{"length", 5000.0}});
+    graph.modifyEdge(11, {{"speed_profile", std::vector<double>(SPEED_PROFILE_VALUES, 3.0)}});
+    return graph;
+}
+
+// Every answer of a, for all node pairs in both metrics, at a departure, and
+// for every POI tag, matches b's
+static void expect_same_answers(const Graph& a, const Graph& b, const char* what) {
+    SearchWorkspace ws;
+    bool same = a.numNodes() == b.numNodes() && a.edges.size() == b.edges.size();
+    std::vector<int> none;
+    RoadTypeMask any;
+    for (int s = 0; same && s < a.numNodes(); s++) {
+        for (int t = 0; same && t < a.numNodes(); t++) {
+            int bs = b.index(a.nodes[s].id), bt = b.index(a.nodes[t].id);
+            for (const char* mode : {"distance", "time"}) {
+                PathResult x = shortest_path(a, ws, s, t, mode, none, any);
+                PathResult y = shortest_path(b, ws, bs, bt, mode, none, any);
+                same = same && x.found == y.found && x.cost == y.cost && x.path == y.path;
+            }
+            PathResult x = time_dependent_shortest_path(a, ws, s, t, 8 * 3600.0, none, any);
+            PathResult y = time_dependent_shortest_path(b, ws, bs, bt, 8 * 3600.0, none, any);
+            same = same && x.found == y.found && x.cost == y.cost;
+        }
+    }
+    for (int tag = 0; same && tag < (int)a.poiTags.size(); tag++) {
+        int btag = b.poiTagId(a.poiTags[tag]);
+        same = btag >= 0 && knn_euclidean(a, 0.0015, 0.0015, tag, 3) == knn_euclidean(b, 0.0015, 0.0015, btag, 3) &&
+               knn_shortest_path(a, ws, 0, tag, 3) == knn_shortest_path(b, ws, b.index(a.nodes[0].id), btag, 3);
+    }
+    expect(same, what);
+}
+
+static void round_trip_answers_like_json() {
+    Graph graph = sample();
+    expect(save_snapshot(SNAPSHOT_PATH, graph), "snapshot saves");
+    Graph loaded;
+    expect(load_snapshot(SNAPSHOT_PATH, loaded), "snapshot loads back");
+    expect_same_answers(graph, loaded, "loaded snapshot answers like the JSON graph");
+
+    // Both keep answering alike once the same update reaches them
+    graph.modifyEdge(2, {{"average_time", 1.0}});
+    loaded.modifyEdge(2, {{"average_time", 1.0}});
+    graph.removeEdge(7);
+    loaded.removeEdge(7);
+    expect_same_answers(graph, loaded, "loaded snapshot answers like the JSON graph after updates");
+}
+
+// Saves a graph whose adjacency was damaged after it was built; load must refuse it
+static void expect_refused(Graph graph, const char* what) {
+    expect(save_snapshot(SNAPSHOT_PATH, graph), "damaged snapshot saves");
+    Graph loaded;
+    expect(!load_snapshot(SNAPSHOT_PATH, loaded), what);
+}
+
+static void corrupt_snapshots_are_refused() {
+    Graph graph = sample();
+
+    Graph selfLoop = graph;
+    selfLoop.arcTarget.write()[0] = 0;// head no longer matches the arc's edge
+    expect_refused(selfLoop, "arc head that disagrees with its edge is refused");
+
+    Graph wrongEdge = graph;
+    wrongEdge.arcEdge.write()[0] = wrongEdge.arcEdge[0] == 0 ? 1 : 0;
+    expect_refused(wrongEdge, "arc pointing at another edge is refused");
+
+    Graph missingReverse = graph;
+    for (size_t i = 0; i < graph.edges.size(); i++) {
+        if (!graph.edges[i].oneway) continue;
+        missingReverse.edges.write(i).oneway = false;// two-way edge with a single arc
+        break;
+    }
+    expect_refused(missingReverse, "two-way edge without a reverse arc is refused");
+
+    Graph wrongReverse = graph;
+    std::vector<int>& revArc = wrongReverse.revArc.write();
+    std::swap(revArc[0], revArc[revArc.size() - 1]);
+    expect_refused(wrongReverse, "reverse CSR that does not mirror the forward one is refused");
+
+    // Cut short, the last sections run past the end of the file
+    expect(save_snapshot(SNAPSHOT_PATH, graph), "snapshot saves");
+    std::filesystem::resize_file(SNAPSHOT_PATH, std::filesystem::file_size(SNAPSHOT_PATH) - 16);
+    Graph loaded;
+    expect(!load_snapshot(SNAPSHOT_PATH, loaded), "truncated snapshot is refused");
+}
+
+int main() {
+    round_trip_answers_like_json();
+    corrupt_snapshots_are_refused();
+    std::filesystem::remove(SNAPSHOT_PATH);
+    if (failures == 0)
+        std::cout << "snapshot_test: all checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Graph.hpp"
+#include "pathfinding.hpp"
+#include "workspace.hpp"
+
+// Time-dependent routing on the edge speed profiles. Times are seconds since
+// midnight of the departure day; the profile repeats every day.
+
+// Travel time of a CSR arc when entered at time t, read from the edge's
+// precomputed function (Graph::buildTtf). Traversal times length/speed are
+// interpolated linearly between bucket starts, and a vehicle may wait at the
+// tail when a later departure arrives sooner, which keeps the result FIFO.
+inline double arc_travel_time(const Graph& graph, int arc, double t) {
+    const TtfRef& f = graph.arcTtf[arc];
+    const TtfPoint* p = graph.ttfPoints.run(f.begin);
+    if (f.count == 1)
+        return p[0].raw;
+
+    const double width = DAY_SECONDS / f.count;
+    double pos = (t - std::floor(t / DAY_SECONDS) * DAY_SECONDS) / width;
+    int b = std::min((int)pos, f.count - 1);
+    int next = (b + 1 == f.count) ? 0 : b + 1;
+    double frac = pos - b;
+
+    double direct = p[b].raw + (p[next].raw - p[b].raw) * frac;
+    double wait = p[next].closed + (1.0 - frac) * width;
+    return std::min(direct, wait);
+}
+
+// Dijkstra on arrival times from `departure`. cost is the travel time, not the clock time
+inline PathResult time_dependent_shortest_path(
+    const Graph& graph,
+    SearchWorkspace& ws,
+    int source,
+    int target,
+    double departure,
+    const std::vector<int>& forbidden_nodes,
+    const RoadTypeMask& forbidden_road_types
+) {
+    const int n = graph.numNodes();
+    if (source < 0 || source >= n || target < 0 || target >= n)
+        return {};
+
+    SearchWorkspace::Side& search = ws.forward;
+    search.reset(n);
+    ws.resetBlocked(n);
+    for (int f : forbidden_nodes)
+        ws.block(f);
+
+    search.label(source, 0.0, -1);
+    search.push(0.0, source);
+
+    while (!search.empty()) {
+        auto [elapsed, u] = search.pop();
+        if (search.settled(u))
+            continue;
+        search.settle(u);
+
+        if (ws.blocked(u))
+            continue;
+
+        if (u == target) {
+            PathResult result;
+            for (int curr = target; curr != -1; curr = search.parentOf(curr))
+                result.path.push_back(curr);
+            std::reverse(result.path.begin(), result.path.end());
+            result.found = true;
+            result.cost = elapsed;
+            return result;
+        }
+
+        for (int a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            int v = graph.arcTarget[a];
+            // Removed edges keep their slot with an infinite weight
+            if (!std::isfinite(graph.arcTime[a]) || ws.blocked(v)) continue;
+            if (!graph.arcAllowed(a, forbidden_road_types)) continue;
+
+            double arrival = elapsed + arc_travel_time(graph, a, departure + elapsed);
+            if (arrival < search.distance(v)) {
+                search.label(v, arrival, u);
+                search.push(arrival, v);
+            }
+        }
+    }
+    return {};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+// Scratch memory for graph searches, owned by the caller (one per worker thread)
+// and reused across queries. Labels are stamped with the generation that wrote
+// them, so starting a new search is O(1) and a query only touches the nodes it
+// actually reaches instead of re-initializing every array.
+class SearchWorkspace {
+public:
+    struct HeapItem {
+        double key;
+        int node;
+        bool operator>(const HeapItem& other) const {
+            return key > other.key;
+        }
+    };
+
+    // Label arrays and queue for one search direction
+    class Side {
+    public:
+        // Starts a new search over a graph with n nodes
+        void reset(int n) {
+            if ((int)seenAt.size() < n) {
+                dist.resize(n);
+                parent.resize(n);
+                seenAt.resize(n, 0);
+                doneAt.resize(n, 0);
+            }
+            if (++generation == 0) {
+                // Stamp counter wrapped, old stamps could look current again
+                std::fill(seenAt.begin(), seenAt.end(), 0);
+                std::fill(doneAt.begin(), doneAt.end(), 0);
+                generation = 1;
+            }
+            heap.clear();
+        }
+
+        bool reached(int v) const { return seenAt[v] == generation; }
+
+        double distance(int v) const {
+            return reached(v) ? dist[v] : std::numeric_limits<double>::infinity();
+        }
+
+        int parentOf(int v) const { return reached(v) ? parent[v] : -1; }
+
+        void label(int v, double d, int p) {
+            seenAt[v] = generation;
+            dist[v] = d;
+            parent[v] = p;
+        }
+
+        bool settled(int v) const { return doneAt[v] == generation; }
+        void settle(int v) { doneAt[v] = generation; }
+
+        // Min-heap with lazy deletion, stale entries are skipped by the caller
+        void push(double key, int node) {
+            heap.push_back({key, node});
+            std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+        }
+
+        bool empty() const { return heap.empty(); }
+        const HeapItem& top() const { return heap.front(); }
+
+        HeapItem pop() {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+            HeapItem item = heap.back();
+            heap.pop_back();
+            return item;
+        }
+
+    private:
+        std::vector<double> dist;
+        std::vector<int> parent;
+        std::vector<uint32_t> seenAt;
+        std::vector<uint32_t> doneAt;
+        std::vector<HeapItem> heap;
+        uint32_t generation = 0;
+    };
+
+    Side forward;
+    Side backward;// second frontier for bidirectional searches
+
+    // Per-query node blocking (forbidden nodes) with the same lazy reset
+    void resetBlocked(int n) {
+        if ((int)blockedAt.size() < n)
+            blockedAt.resize(n, 0);
+        if (++blockGeneration == 0) {
+            std::fill(blockedAt.begin(), blockedAt.end(), 0);
+            blockGeneration = 1;
+        }
+    }
+
+    void block(int v) { blockedAt[v] = blockGeneration; }
+    bool blocked(int v) const { return blockedAt[v] == blockGeneration; }
+
+private:
+    std::vector<uint32_t> blockedAt;
+    uint32_t blockGeneration = 0;
+};